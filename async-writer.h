@@ -0,0 +1,265 @@
+#ifndef ASYNC_WRITER_H
+#define ASYNC_WRITER_H
+
+#include "ns3/core-module.h"
+#include "ns3/system-thread.h"
+
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+/*
+ * AsyncWriter moves file output off the simulation thread.
+ *
+ * Write() only copies the bytes into a single-producer/single-consumer ring
+ * and returns; a background thread drains the ring into the file in large
+ * fwrite calls. The ring never blocks the producer: a record that does not
+ * fit in the free space is dropped whole and counted. The ring is lock-free,
+ * the two sides only share the head and tail counters, which are accessed
+ * with acquire/release atomics.
+ *
+ * Only the thread that opened the writer may call Write() and Close().
+ */
+class AsyncWriter
+{
+public:
+
+  AsyncWriter ();
+  ~AsyncWriter ();
+
+  /// queueBytes is rounded up to a power of two
+  bool Open (std::string fileName, uint32_t queueBytes = 4 * 1024 * 1024);
+  /// Queue one record, false if it was dropped because the queue was full
+  bool Write (const void *data, uint32_t length);
+  bool Write (const std::string &record);
+  /// Queue one record, waiting for the writer thread to make room; false if it can never fit
+  bool WriteWait (const void *data, uint32_t length);
+  /// Drain what is queued, stop the thread and close the file
+  void Close (void);
+
+  bool IsOpen (void) const;
+  uint64_t GetRecordsQueued (void) const;
+  uint64_t GetRecordsDropped (void) const;
+  uint64_t GetBytesDropped (void) const;
+  /// Most bytes ever waiting in the queue
+  uint32_t GetHighWaterMark (void) const;
+
+private:
+  void Drain (void);
+
+  static uint64_t Load (const uint64_t *counter);
+  static void Store (uint64_t *counter, uint64_t value);
+
+  std::FILE            *m_file;
+  std::vector<uint8_t>  m_ring;
+  uint64_t              m_mask;
+  Ptr<SystemThread>     m_thread;
+
+  // Shared between the two threads
+  uint64_t              m_head;
+  uint64_t              m_tail;
+  uint64_t              m_closing;
+
+  // Producer side only
+  uint64_t              m_records;
+  uint64_t              m_dropped;
+  uint64_t              m_bytesDropped;
+  uint32_t              m_highWater;
+};
+
+AsyncWriter::AsyncWriter ()
+  : m_file (0),
+    m_mask (0),
+    m_thread (0),
+    m_head (0),
+    m_tail (0),
+    m_closing (0),
+    m_records (0),
+    m_dropped (0),
+    m_bytesDropped (0),
+    m_highWater (0)
+{
+}
+
+AsyncWriter::~AsyncWriter ()
+{
+  Close ();
+}
+
+uint64_t
+AsyncWriter::Load (const uint64_t *counter)
+{
+  return __atomic_load_n (counter, __ATOMIC_ACQUIRE);
+}
+
+void
+AsyncWriter::Store (uint64_t *counter, uint64_t value)
+{
+  __atomic_store_n (counter, value, __ATOMIC_RELEASE);
+}
+
+bool
+AsyncWriter::Open (std::string fileName, uint32_t queueBytes)
+{
+  Close ();
+  m_file = std::fopen (fileName.c_str (), "wb");
+  if (!m_file)
+    {
+      std::cerr << "Error: Can't open " << fileName << "\n";
+      return false;
+    }
+  // Only the writer thread touches the file, give it large writes
+  std::setvbuf (m_file, 0, _IOFBF, 1024 * 1024);
+
+  uint64_t size = 4096;
+  while (size < queueBytes)
+    {
+      size <<= 1;
+    }
+  m_ring.resize (size);
+  m_mask = size - 1;
+  m_head = 0;
+  m_tail = 0;
+  m_closing = 0;
+  m_records = 0;
+  m_dropped = 0;
+  m_bytesDropped = 0;
+  m_highWater = 0;
+
+  m_thread = Create<SystemThread> (MakeCallback (&AsyncWriter::Drain, this));
+  m_thread->Start ();
+  return true;
+}
+
+bool
+AsyncWriter::Write (const void *data, uint32_t length)
+{
+  if (!m_file)
+    {
+      return false;
+    }
+
+  uint64_t tail = m_tail;
+  uint64_t used = tail - Load (&m_head);
+  if (used + length > m_ring.size ())
+    {
+      m_dropped++;
+      m_bytesDropped += length;
+      return false;
+    }
+
+  const uint8_t *bytes = static_cast<const uint8_t *> (data);
+  uint64_t offset = tail & m_mask;
+  uint64_t first = std::min<uint64_t> (length, m_ring.size () - offset);
+  std::memcpy (&m_ring[offset], bytes, first);
+  std::memcpy (&m_ring[0], bytes + first, length - first);
+  Store (&m_tail, tail + length);
+
+  m_records++;
+  if (used + length > m_highWater)
+    {
+      m_highWater = used + length;
+    }
+  return true;
+}
+
+bool
+AsyncWriter::Write (const std::string &record)
+{
+  return Write (record.data (), record.size ());
+}
+
+bool
+AsyncWriter::WriteWait (const void *data, uint32_t length)
+{
+  if (!m_file || length > m_ring.size ())
+    {
+      return false;
+    }
+  while (m_tail - Load (&m_head) + length > m_ring.size ())
+    {
+      usleep (100);
+    }
+  return Write (data, length);
+}
+
+void
+AsyncWriter::Drain (void)
+{
+  while (true)
+    {
+      // Read the closing flag first so nothing queued before it is missed
+      bool closing = Load (&m_closing) != 0;
+      uint64_t head = m_head;
+      uint64_t tail = Load (&m_tail);
+      if (head == tail)
+        {
+          if (closing)
+            {
+              break;
+            }
+          usleep (1000);
+          continue;
+        }
+
+      // Write the contiguous part, the wrapped part goes on the next pass
+      uint64_t offset = head & m_mask;
+      uint64_t length = std::min<uint64_t> (tail - head, m_ring.size () - offset);
+      std::fwrite (&m_ring[offset], 1, length, m_file);
+      Store (&m_head, head + length);
+    }
+  std::fflush (m_file);
+}
+
+void
+AsyncWriter::Close (void)
+{
+  if (!m_file)
+    {
+      return;
+    }
+  Store (&m_closing, 1);
+  m_thread->Join ();
+  m_thread = 0;
+  std::fclose (m_file);
+  m_file = 0;
+}
+
+bool
+AsyncWriter::IsOpen (void) const
+{
+  return m_file != 0;
+}
+
+uint64_t
+AsyncWriter::GetRecordsQueued (void) const
+{
+  return m_records;
+}
+
+uint64_t
+AsyncWriter::GetRecordsDropped (void) const
+{
+  return m_dropped;
+}
+
+uint64_t
+AsyncWriter::GetBytesDropped (void) const
+{
+  return m_bytesDropped;
+}
+
+uint32_t
+AsyncWriter::GetHighWaterMark (void) const
+{
+  return m_highWater;
+}
+
+#endif /* ASYNC_WRITER_H */
@@ -66,6 +66,12 @@
 #include "ns3/ipv4-flow-classifier.h"
 #include "ns3/flow-monitor.h"
 #include "ns3/animation-interface.h"
+#include "flow-engine.h"
+#include "column-file.h"
+#include "rng-streams.h"
+#include "bench-report.h"
+#include "ladder-scheduler.h"
+#include "warmup-fork.h"
 //#include "ns3/wifi-phy.h"
 //#include <iostream>
 //#include <sstream>
@@ -76,6 +82,13 @@
 
 using namespace ns3;
 
+// Traffic rate of a variant forked after the warm-up
+static void
+SetOnOffRate (std::string rate)
+{
+  Config::Set ("/NodeList/*/ApplicationList/*/$ns3::OnOffApplication/DataRate", StringValue (rate));
+}
+
 int main (int argc, char *argv[])
 {
   ns3::PacketMetadata::Enable ();
@@ -98,12 +111,19 @@ int main (int argc, char *argv[])
   bool m_mobile = false; // Mesh nodes are mobile
   bool m_newFlowFile = false; // Clear flow .csv file
   bool m_drawAnim = false; // Enable netanim .xls output
+  bool m_flowEngine = false; // Drive internet -> mesh flows from one FlowEngine
   std::string m_txAppRate = "128kbps"; // Transmision speed for apps
   std::string m_txInternetRate = "1Mbps"; // Transmision speed to n0 <-> n1 link
   std::string m_animFile = "resultados/basev4-aodv.xml"; // File for .xml
   std::string m_routeFile = "resultados/basev4-aodv-route.xml"; // File for .xml routing
   std::string m_statsFile = "resultados/basev4-aodv-3x3"; // Prefix for statistics output files
   std::string m_flowmonFile = "resultados/basev4-aodv.flowmon"; // File for flowmon output
+  std::string m_resultFile = ""; // Columnar per-run flow results, none if empty
+  uint32_t m_run = 0; // Replication number, 0 keeps --RngRun
+  std::string m_benchFile = ""; // Events and timings of this run as JSON, none if empty
+  std::string m_scheduler = "map"; // Simulator event scheduler, see ladder-scheduler.h
+  std::string m_forkRates = ""; // App rates to fork into once routes are up, none if empty
+  uint32_t m_forkJobs = 1; // Forked variants running at once
   int tmp_x;
   char tmp_char [30] = "";
 
@@ -119,12 +139,36 @@ int main (int argc, char *argv[])
   cmd.AddValue ("app-tx-rate", "Set speed of traffic generation", m_txAppRate);
   cmd.AddValue ("link-speed", "Transmision speed over P2P link", m_txInternetRate);
   cmd.AddValue ("enable-anim", "Enable output for .xml animation", m_drawAnim);
+  cmd.AddValue ("flow-engine", "Use a single FlowEngine on n0 instead of one OnOff app per internet flow", m_flowEngine);
   cmd.AddValue ("anim-file", "Set output name for .xml animation file", m_animFile);
   cmd.AddValue ("route-file", "Set output name for route file", m_routeFile);
   cmd.AddValue ("stats-file", "Set output prefix for .csv flows results file", m_statsFile);
   cmd.AddValue ("new-flow-file", "Clear .csv flows results file", m_newFlowFile);
   cmd.AddValue ("flow-file", "Set output name for flow monitor .flowmon file", m_flowmonFile);
+  cmd.AddValue ("result-file", "Also write per-flow results of this run to a columnar file (.cols), see flow-results", m_resultFile);
+  cmd.AddValue ("run", "Replication number, each one draws from independent random substreams", m_run);
+  cmd.AddValue ("bench-file", "Write events and timings of this run as JSON, see scenario-bench", m_benchFile);
+  cmd.AddValue ("scheduler", "Event scheduler: map, heap, list, calendar or ladder", m_scheduler);
+  cmd.AddValue ("fork-rates", "Comma separated app-tx-rate values, run the warm-up once and fork one process per rate before traffic starts", m_forkRates);
+  cmd.AddValue ("fork-jobs", "Forked rates running at once", m_forkJobs);
   cmd.Parse (argc, argv);
+  BenchReport::Start (m_benchFile);
+  if (!SchedulerOption::Set (m_scheduler))
+  {
+    return 1;
+  }
+  if (!m_forkRates.empty () && m_flowEngine)
+  {
+    std::cerr << "Error: --fork-rates sets the rate of the OnOff apps, it can't be used with --flow-engine\n";
+    return 1;
+  }
+  if (!m_forkRates.empty () && !m_benchFile.empty ())
+  {
+    std::cerr << "Error: --fork-rates runs the warm-up once for every rate, it can't be used with --bench-file\n";
+    return 1;
+  }
+  RngStreams::SetRun (m_run);
+  RngStreams streams; // Streams are handed out in a fixed order, see rng-streams.h
 
 // Node container creation (all node containers starts with "nc_")
   NodeContainer nc_all; // Contains every node (starting with internet node, access nodes and then mesh nodes
@@ -227,11 +271,14 @@ int main (int argc, char *argv[])
 // Set traffic generator apps
   Config::SetDefault ("ns3::OnOffApplication::PacketSize", UintegerValue (m_packetSize));
   Config::SetDefault ("ns3::OnOffApplication::DataRate", StringValue (m_txAppRate));
-  std::ostringstream oss_crv;
-  oss_crv << "ns3::ConstantRandomVariable[Constant=" << std::rand () % 10 << "]";
-  Config::SetDefault ("ns3::OnOffApplication::OnTime", StringValue (oss_crv.str ()));
-  oss_crv << "ns3::ConstantRandomVariable[Constant=" << std::rand () % 10 << "]";
-  Config::SetDefault ("ns3::OnOffApplication::OffTime", StringValue (oss_crv.str ()));
+  Ptr<UniformRandomVariable> onOffTime = CreateObject<UniformRandomVariable> (); // On/Off times for this run
+  onOffTime->SetStream (streams.Allocate ());
+  std::ostringstream oss_on;
+  oss_on << "ns3::ConstantRandomVariable[Constant=" << onOffTime->GetInteger (0, 9) << "]";
+  Config::SetDefault ("ns3::OnOffApplication::OnTime", StringValue (oss_on.str ()));
+  std::ostringstream oss_off;
+  oss_off << "ns3::ConstantRandomVariable[Constant=" << onOffTime->GetInteger (0, 9) << "]";
+  Config::SetDefault ("ns3::OnOffApplication::OffTime", StringValue (oss_off.str ()));
   //Config::SetDefault ("ns3::OnOffApplication::OnTime", StringValue ("ns3::ConstantRandomVariable[Constant=10.0]"));
   //Config::SetDefault ("ns3::OnOffApplication::OffTime", StringValue ("ns3::ConstantRandomVariable[Constant=2.0]"));
 
@@ -243,13 +290,29 @@ int main (int argc, char *argv[])
   ac_onoffMesh.Start (Seconds (30));
   ac_onoffMesh.Stop (Seconds (m_totalTime - 10));
 
-  ApplicationContainer ac_onoffInternet [m_xNodes * m_yNodes]; // Creates 1 OnOff App for each mesh node FROM internet
-  for (tmp_x = 0; tmp_x < m_xNodes * m_yNodes; tmp_x++)
+  if (m_flowEngine) // Creates 1 FlowEngine on n0 driving every flow FROM internet
+  {
+    Ptr<FlowEngine> engine = CreateObject<FlowEngine> ();
+    for (tmp_x = 0; tmp_x < m_xNodes * m_yNodes; tmp_x++)
+    {
+      Ptr<Socket> socket = Socket::CreateSocket (nc_all.Get (0), TcpSocketFactory::GetTypeId ());
+      engine->AddFlow (socket, InetSocketAddress (if_mesh.GetAddress (tmp_x), 9), m_packetSize, 0,
+                       DataRate (m_txAppRate), Seconds (30), Seconds (m_totalTime - 5));
+    }
+    nc_all.Get (0)->AddApplication (engine);
+    engine->SetStartTime (Seconds (30));
+    engine->SetStopTime (Seconds (m_totalTime - 5));
+  }
+  else
   {
-    OnOffHelper onoffInternet ("ns3::TcpSocketFactory", Address (InetSocketAddress (if_mesh.GetAddress (tmp_x), 9)));
-    ac_onoffInternet [tmp_x] = onoffInternet.Install (nc_all.Get (0));
-    ac_onoffInternet [tmp_x].Start (Seconds (30));
-    ac_onoffInternet [tmp_x].Stop (Seconds (m_totalTime - 5));
+    ApplicationContainer ac_onoffInternet [m_xNodes * m_yNodes]; // Creates 1 OnOff App for each mesh node FROM internet
+    for (tmp_x = 0; tmp_x < m_xNodes * m_yNodes; tmp_x++)
+    {
+      OnOffHelper onoffInternet ("ns3::TcpSocketFactory", Address (InetSocketAddress (if_mesh.GetAddress (tmp_x), 9)));
+      ac_onoffInternet [tmp_x] = onoffInternet.Install (nc_all.Get (0));
+      ac_onoffInternet [tmp_x].Start (Seconds (30));
+      ac_onoffInternet [tmp_x].Stop (Seconds (m_totalTime - 5));
+    }
   }
 
 /////PING FOR TESTS
@@ -299,8 +362,40 @@ int main (int argc, char *argv[])
   monitor->Stop (Seconds (m_totalTime));
 	monitor->SerializeToXmlFile (m_flowmonFile, true, true);
 
+// Fix the random streams of everything installed above
+  streams.Assign (wifi, de_wireless);
+  streams.Assign (internetStack, nc_all);
+  streams.Assign (aodv, nc_all);
+  streams.AssignNodes (nc_all);
+
+// Fork the rate variants just before the apps start at 30 s, each one writes its own results
+  if (!m_forkRates.empty ())
+  {
+    std::vector<std::string> rates;
+    std::istringstream in (m_forkRates);
+    std::string rate;
+    while (std::getline (in, rate, ','))
+    {
+      rates.push_back (rate);
+    }
+    WarmupFork::Schedule (Seconds (30) - MilliSeconds (1), rates, MakeCallback (&SetOnOffRate), m_forkJobs);
+  }
+
 // Run the simulation
+  BenchReport::SetupDone ();
   Simulator::Run ();
+  BenchReport::Finish ();
+  if (WarmupFork::IsParent ())
+  {
+    Simulator::Destroy ();
+    return WarmupFork::GetFailed () > 0 ? 1 : 0;
+  }
+  if (!WarmupFork::GetVariant ().empty ())
+  {
+    m_txAppRate = WarmupFork::GetVariant ();
+    m_statsFile = WarmupFork::Decorate (m_statsFile);
+    m_resultFile = WarmupFork::Decorate (m_resultFile);
+  }
 
 //////////// Log data
 
@@ -334,12 +429,80 @@ int main (int argc, char *argv[])
     of << t.sourceAddress << "\t" << t.destinationAddress << "\t";
     of << t.sourcePort << "\t" << t.destinationPort << "\t";
     of << i->second.timeFirstTxPacket.GetSeconds() << "\t" << i->second.timeLastTxPacket.GetSeconds() << "\t";
-    of << i->second.timeFirstRxPacket.GetSeconds() << "\t" << i->second.timeLastTxPacket.GetSeconds() << "\t";
+    of << i->second.timeFirstRxPacket.GetSeconds() << "\t" << i->second.timeLastRxPacket.GetSeconds() << "\t";
     of << i->second.txBytes << "\t" << i->second.rxBytes << "\t";
     of << i->second.txPackets << "\t" << i->second.rxPackets << "\n";
   }
   of << """AODV""\t" << m_xNodes << "x" << m_yNodes <<"\n";
   of.close ();
+
+// Same per flow statistics, one columnar file per run
+  if (!m_resultFile.empty ())
+  {
+    ColumnFileWriter results;
+    uint32_t c_srcAddr = results.AddColumn ("srcAddr", ColumnFileWriter::UINT32);
+    uint32_t c_dstAddr = results.AddColumn ("dstAddr", ColumnFileWriter::UINT32);
+    uint32_t c_srcPort = results.AddColumn ("srcPort", ColumnFileWriter::UINT32);
+    uint32_t c_dstPort = results.AddColumn ("dstPort", ColumnFileWriter::UINT32);
+    uint32_t c_firstTx = results.AddColumn ("timeFirstTxPacket", ColumnFileWriter::DOUBLE);
+    uint32_t c_lastTx = results.AddColumn ("timeLastTxPacket", ColumnFileWriter::DOUBLE);
+    uint32_t c_firstRx = results.AddColumn ("timeFirstRxPacket", ColumnFileWriter::DOUBLE);
+    uint32_t c_lastRx = results.AddColumn ("timeLastRxPacket", ColumnFileWriter::DOUBLE);
+    uint32_t c_delaySum = results.AddColumn ("delaySum", ColumnFileWriter::DOUBLE);
+    uint32_t c_txBytes = results.AddColumn ("txBytes", ColumnFileWriter::UINT64);
+    uint32_t c_rxBytes = results.AddColumn ("rxBytes", ColumnFileWriter::UINT64);
+    uint32_t c_txPackets = results.AddColumn ("txPackets", ColumnFileWriter::UINT32);
+    uint32_t c_rxPackets = results.AddColumn ("rxPackets", ColumnFileWriter::UINT32);
+    uint32_t c_lostPackets = results.AddColumn ("lostPackets", ColumnFileWriter::UINT32);
+    for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
+    {
+      Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
+      results.AppendUint (c_srcAddr, t.sourceAddress.Get ());
+      results.AppendUint (c_dstAddr, t.destinationAddress.Get ());
+      results.AppendUint (c_srcPort, t.sourcePort);
+      results.AppendUint (c_dstPort, t.destinationPort);
+      results.AppendDouble (c_firstTx, i->second.timeFirstTxPacket.GetSeconds ());
+      results.AppendDouble (c_lastTx, i->second.timeLastTxPacket.GetSeconds ());
+      results.AppendDouble (c_firstRx, i->second.timeFirstRxPacket.GetSeconds ());
+      results.AppendDouble (c_lastRx, i->second.timeLastRxPacket.GetSeconds ());
+      results.AppendDouble (c_delaySum, i->second.delaySum.GetSeconds ());
+      results.AppendUint (c_txBytes, i->second.txBytes);
+      results.AppendUint (c_rxBytes, i->second.rxBytes);
+      results.AppendUint (c_txPackets, i->second.txPackets);
+      results.AppendUint (c_rxPackets, i->second.rxPackets);
+      results.AppendUint (c_lostPackets, i->second.lostPackets);
+    }
+    std::ostringstream param;
+    param << m_xNodes;
+    results.SetParameter ("mesh-width", param.str ());
+    param.str ("");
+    param << m_yNodes;
+    results.SetParameter ("mesh-height", param.str ());
+    param.str ("");
+    param << m_distNodes;
+    results.SetParameter ("node-distance", param.str ());
+    param.str ("");
+    param << m_distAP;
+    results.SetParameter ("ap-distance", param.str ());
+    param.str ("");
+    param << m_totalTime;
+    results.SetParameter ("time", param.str ());
+    param.str ("");
+    param << m_packetSize;
+    results.SetParameter ("app-packet-size", param.str ());
+    results.SetParameter ("app-tx-rate", m_txAppRate);
+    results.SetParameter ("link-speed", m_txInternetRate);
+    results.SetParameter ("mobile", m_mobile ? "1" : "0");
+    results.SetParameter ("flow-engine", m_flowEngine ? "1" : "0");
+    results.SetParameter ("routing", "AODV");
+    param.str ("");
+    param << RngSeedManager::GetSeed ();
+    results.SetParameter ("seed", param.str ());
+    param.str ("");
+    param << RngSeedManager::GetRun ();
+    results.SetParameter ("run", param.str ());
+    results.Write (m_resultFile);
+  }
 //////////// End Log data
 
   Simulator::Destroy ();
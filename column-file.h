@@ -0,0 +1,410 @@
+#ifndef COLUMN_FILE_H
+#define COLUMN_FILE_H
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <stdint.h>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+/*
+ * Columnar result files, one per simulation run.
+ *
+ * Layout, integers in the byte order recorded in the header:
+ *
+ *   header:   char magic[8] = "NS3COLS1", uint32 byte order mark = 0x01020304,
+ *             uint32 column count, uint64 row count
+ *   schema:   per column: uint8 type (1 = uint32, 2 = uint64, 3 = double),
+ *             uint8 name length, char name[]
+ *   data:     per column, starting at the next multiple of 8: row count values
+ *   footer:   uint32 parameter count, then per parameter:
+ *             uint16 key length, char key[], uint16 value length, char value[]
+ *   trailer:  uint64 footer offset, char magic[8] = "NS3COLS$"
+ *
+ * The data blocks are 8-byte aligned so a reader can mmap the file and use
+ * them in place. A file without a valid trailer (a run that crashed while
+ * writing) is rejected by the reader.
+ */
+class ColumnFileWriter
+{
+public:
+
+  enum Type
+  {
+    UINT32 = 1,
+    UINT64 = 2,
+    DOUBLE = 3
+  };
+
+  /// Add a column, returns its index
+  uint32_t AddColumn (std::string name, Type type);
+  void AppendUint (uint32_t column, uint64_t value);
+  void AppendDouble (uint32_t column, double value);
+  /// Run parameter stored in the footer
+  void SetParameter (std::string key, std::string value);
+
+  bool Write (std::string fileName) const;
+
+private:
+  static uint32_t Width (Type type);
+
+  std::vector<std::string>           m_names;
+  std::vector<Type>                  m_types;
+  std::vector<std::vector<uint64_t> > m_uints;
+  std::vector<std::vector<double> >   m_doubles;
+  std::map<std::string, std::string>  m_parameters;
+};
+
+class ColumnFileReader
+{
+public:
+
+  ColumnFileReader ();
+  ~ColumnFileReader ();
+
+  bool Open (std::string fileName);
+  void Close (void);
+
+  uint64_t GetNRows (void) const;
+  uint32_t GetNColumns (void) const;
+  std::string GetColumnName (uint32_t column) const;
+  ColumnFileWriter::Type GetColumnType (uint32_t column) const;
+  /// Column index by name, -1 if missing
+  int FindColumn (std::string name) const;
+  /// Value of a row as double, whatever the column type
+  double GetValue (uint32_t column, uint64_t row) const;
+  const uint32_t *GetUint32 (uint32_t column) const;
+  const uint64_t *GetUint64 (uint32_t column) const;
+  const double *GetDouble (uint32_t column) const;
+  /// Run parameter, empty if missing
+  std::string GetParameter (std::string key) const;
+
+private:
+  uint8_t                           *m_map;
+  uint64_t                           m_size;
+  uint64_t                           m_rows;
+  std::vector<std::string>           m_names;
+  std::vector<ColumnFileWriter::Type> m_types;
+  std::vector<const uint8_t *>       m_data;
+  std::map<std::string, std::string> m_parameters;
+};
+
+uint32_t
+ColumnFileWriter::Width (Type type)
+{
+  return type == UINT32 ? 4 : 8;
+}
+
+uint32_t
+ColumnFileWriter::AddColumn (std::string name, Type type)
+{
+  m_names.push_back (name);
+  m_types.push_back (type);
+  m_uints.push_back (std::vector<uint64_t> ());
+  m_doubles.push_back (std::vector<double> ());
+  return m_names.size () - 1;
+}
+
+void
+ColumnFileWriter::AppendUint (uint32_t column, uint64_t value)
+{
+  m_uints[column].push_back (value);
+}
+
+void
+ColumnFileWriter::AppendDouble (uint32_t column, double value)
+{
+  m_doubles[column].push_back (value);
+}
+
+void
+ColumnFileWriter::SetParameter (std::string key, std::string value)
+{
+  m_parameters[key] = value;
+}
+
+bool
+ColumnFileWriter::Write (std::string fileName) const
+{
+  uint64_t rows = m_names.empty () ? 0 : m_uints[0].size () + m_doubles[0].size ();
+  for (uint32_t c = 0; c < m_names.size (); ++c)
+    {
+      if (m_uints[c].size () + m_doubles[c].size () != rows)
+        {
+          std::cerr << "Error: Column " << m_names[c] << " of " << fileName << " has a different row count\n";
+          return false;
+        }
+    }
+
+  std::vector<uint8_t> out;
+  out.insert (out.end (), "NS3COLS1", "NS3COLS1" + 8);
+  uint32_t bom = 0x01020304;
+  uint32_t columns = m_names.size ();
+  out.insert (out.end (), reinterpret_cast<uint8_t *> (&bom), reinterpret_cast<uint8_t *> (&bom) + 4);
+  out.insert (out.end (), reinterpret_cast<uint8_t *> (&columns), reinterpret_cast<uint8_t *> (&columns) + 4);
+  out.insert (out.end (), reinterpret_cast<uint8_t *> (&rows), reinterpret_cast<uint8_t *> (&rows) + 8);
+  for (uint32_t c = 0; c < columns; ++c)
+    {
+      out.push_back (m_types[c]);
+      out.push_back (m_names[c].size () & 0xff);
+      out.insert (out.end (), m_names[c].begin (), m_names[c].begin () + (m_names[c].size () & 0xff));
+    }
+
+  for (uint32_t c = 0; c < columns; ++c)
+    {
+      out.resize ((out.size () + 7) & ~static_cast<uint64_t> (7), 0);
+      uint64_t offset = out.size ();
+      out.resize (offset + rows * Width (m_types[c]));
+      uint8_t *p = &out[0] + offset;
+      for (uint64_t r = 0; r < rows; ++r)
+        {
+          if (m_types[c] == UINT32)
+            {
+              uint32_t v = m_uints[c][r];
+              std::memcpy (p + r * 4, &v, 4);
+            }
+          else if (m_types[c] == UINT64)
+            {
+              std::memcpy (p + r * 8, &m_uints[c][r], 8);
+            }
+          else
+            {
+              std::memcpy (p + r * 8, &m_doubles[c][r], 8);
+            }
+        }
+    }
+
+  uint64_t footer = out.size ();
+  uint32_t count = m_parameters.size ();
+  out.insert (out.end (), reinterpret_cast<uint8_t *> (&count), reinterpret_cast<uint8_t *> (&count) + 4);
+  for (std::map<std::string, std::string>::const_iterator it = m_parameters.begin (); it != m_parameters.end (); ++it)
+    {
+      const std::string *field[2] = { &it->first, &it->second };
+      for (int f = 0; f < 2; ++f)
+        {
+          uint16_t length = field[f]->size () & 0xffff;
+          out.insert (out.end (), reinterpret_cast<uint8_t *> (&length), reinterpret_cast<uint8_t *> (&length) + 2);
+          out.insert (out.end (), field[f]->begin (), field[f]->begin () + length);
+        }
+    }
+  out.insert (out.end (), reinterpret_cast<uint8_t *> (&footer), reinterpret_cast<uint8_t *> (&footer) + 8);
+  out.insert (out.end (), "NS3COLS$", "NS3COLS$" + 8);
+
+  // Write under a temporary name so a crash never leaves a half file behind
+  std::string tmp = fileName + ".tmp";
+  std::ofstream file (tmp.c_str (), std::ios::out | std::ios::binary | std::ios::trunc);
+  file.write (reinterpret_cast<const char *> (&out[0]), out.size ());
+  file.close ();
+  if (!file || std::rename (tmp.c_str (), fileName.c_str ()) != 0)
+    {
+      std::cerr << "Error: Can't write " << fileName << "\n";
+      return false;
+    }
+  return true;
+}
+
+ColumnFileReader::ColumnFileReader ()
+  : m_map (0),
+    m_size (0),
+    m_rows (0)
+{
+}
+
+ColumnFileReader::~ColumnFileReader ()
+{
+  Close ();
+}
+
+void
+ColumnFileReader::Close (void)
+{
+  if (m_map)
+    {
+      munmap (m_map, m_size);
+      m_map = 0;
+    }
+  m_size = 0;
+  m_rows = 0;
+  m_names.clear ();
+  m_types.clear ();
+  m_data.clear ();
+  m_parameters.clear ();
+}
+
+bool
+ColumnFileReader::Open (std::string fileName)
+{
+  Close ();
+  int fd = open (fileName.c_str (), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || fstat (fd, &st) != 0)
+    {
+      std::cerr << "Error: Can't open " << fileName << "\n";
+      if (fd >= 0)
+        {
+          close (fd);
+        }
+      return false;
+    }
+  m_size = st.st_size;
+  void *map = m_size >= 40 ? mmap (0, m_size, PROT_READ, MAP_PRIVATE, fd, 0) : MAP_FAILED;
+  close (fd);
+  if (map == MAP_FAILED)
+    {
+      std::cerr << "Error: " << fileName << " is not a column file\n";
+      m_size = 0;
+      return false;
+    }
+  m_map = static_cast<uint8_t *> (map);
+
+  uint32_t bom;
+  uint32_t columns;
+  uint64_t footer;
+  std::memcpy (&bom, m_map + 8, 4);
+  std::memcpy (&columns, m_map + 12, 4);
+  std::memcpy (&m_rows, m_map + 16, 8);
+  std::memcpy (&footer, m_map + m_size - 16, 8);
+  if (std::memcmp (m_map, "NS3COLS1", 8) != 0 || std::memcmp (m_map + m_size - 8, "NS3COLS$", 8) != 0
+      || bom != 0x01020304 || footer > m_size - 20)
+    {
+      std::cerr << "Error: " << fileName << " is not a complete column file for this byte order\n";
+      Close ();
+      return false;
+    }
+
+  uint64_t offset = 24;
+  for (uint32_t c = 0; c < columns; ++c)
+    {
+      if (offset + 2 > footer)
+        {
+          std::cerr << "Error: " << fileName << " has a truncated schema\n";
+          Close ();
+          return false;
+        }
+      if (m_map[offset] < ColumnFileWriter::UINT32 || m_map[offset] > ColumnFileWriter::DOUBLE)
+        {
+          std::cerr << "Error: " << fileName << " has an unknown column type\n";
+          Close ();
+          return false;
+        }
+      m_types.push_back (static_cast<ColumnFileWriter::Type> (m_map[offset]));
+      m_names.push_back (std::string (reinterpret_cast<char *> (m_map + offset + 2), m_map[offset + 1]));
+      offset += 2 + m_map[offset + 1];
+    }
+  for (uint32_t c = 0; c < columns; ++c)
+    {
+      offset = (offset + 7) & ~static_cast<uint64_t> (7);
+      m_data.push_back (m_map + offset);
+      offset += m_rows * (m_types[c] == ColumnFileWriter::UINT32 ? 4 : 8);
+    }
+  if (offset > footer)
+    {
+      std::cerr << "Error: " << fileName << " has truncated columns\n";
+      Close ();
+      return false;
+    }
+
+  uint32_t count;
+  std::memcpy (&count, m_map + footer, 4);
+  offset = footer + 4;
+  for (uint32_t i = 0; i < count; ++i)
+    {
+      std::string field[2];
+      for (int f = 0; f < 2 && offset + 2 <= m_size - 16; ++f)
+        {
+          uint16_t length;
+          std::memcpy (&length, m_map + offset, 2);
+          field[f].assign (reinterpret_cast<char *> (m_map + offset + 2), std::min<uint64_t> (length, m_size - 16 - offset - 2));
+          offset += 2 + length;
+        }
+      m_parameters[field[0]] = field[1];
+    }
+  return true;
+}
+
+uint64_t
+ColumnFileReader::GetNRows (void) const
+{
+  return m_rows;
+}
+
+uint32_t
+ColumnFileReader::GetNColumns (void) const
+{
+  return m_names.size ();
+}
+
+std::string
+ColumnFileReader::GetColumnName (uint32_t column) const
+{
+  return m_names[column];
+}
+
+ColumnFileWriter::Type
+ColumnFileReader::GetColumnType (uint32_t column) const
+{
+  return m_types[column];
+}
+
+int
+ColumnFileReader::FindColumn (std::string name) const
+{
+  for (uint32_t c = 0; c < m_names.size (); ++c)
+    {
+      if (m_names[c] == name)
+        {
+          return c;
+        }
+    }
+  return -1;
+}
+
+double
+ColumnFileReader::GetValue (uint32_t column, uint64_t row) const
+{
+  switch (m_types[column])
+    {
+    case ColumnFileWriter::UINT32:
+      return GetUint32 (column)[row];
+    case ColumnFileWriter::UINT64:
+      return GetUint64 (column)[row];
+    default:
+      return GetDouble (column)[row];
+    }
+}
+
+const uint32_t *
+ColumnFileReader::GetUint32 (uint32_t column) const
+{
+  return reinterpret_cast<const uint32_t *> (m_data[column]);
+}
+
+const uint64_t *
+ColumnFileReader::GetUint64 (uint32_t column) const
+{
+  return reinterpret_cast<const uint64_t *> (m_data[column]);
+}
+
+const double *
+ColumnFileReader::GetDouble (uint32_t column) const
+{
+  return reinterpret_cast<const double *> (m_data[column]);
+}
+
+std::string
+ColumnFileReader::GetParameter (std::string key) const
+{
+  std::map<std::string, std::string>::const_iterator it = m_parameters.find (key);
+  return it == m_parameters.end () ? std::string () : it->second;
+}
+
+#endif /* COLUMN_FILE_H */
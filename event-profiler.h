@@ -0,0 +1,399 @@
+#ifndef EVENT_PROFILER_H
+#define EVENT_PROFILER_H
+
+#include "ns3/core-module.h"
+
+#include <cxxabi.h>
+#include <sys/time.h>
+#include <time.h>
+#if defined (__x86_64__) || defined (__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <string>
+#include <typeinfo>
+#include <vector>
+
+using namespace ns3;
+
+/*
+ * EventProfiler attributes the time spent in Simulator::Run () to the
+ * targets of the events, e.g. YansWifiPhy, olsr::RoutingProtocol or
+ * FlowMonitor methods.
+ *
+ * Enable() swaps the simulator scheduler for a ProfilingScheduler that
+ * wraps the usual one. Every event it hands to the simulator goes through
+ * one reused wrapper that reads the TSC around the real event and charges
+ * the cycles and one count to the event's C++ type. For events made with
+ * Simulator::Schedule that type names the member function or function
+ * scheduled, so the target is its class and signature. Nothing is
+ * allocated per event; the cost is two TSC reads and a map lookup.
+ *
+ * After the run, WriteFlat() prints the targets sorted by time and
+ * WriteFolded() writes them in the folded-stack format of flamegraph.pl,
+ * one line per target:  Simulator::Run;<class>;<target> <microseconds>
+ *
+ * Enable() once, before Simulator::Run (); the scheduler must not be
+ * changed again afterwards.
+ */
+class EventProfiler
+{
+public:
+
+  /// Run the simulator on a ProfilingScheduler wrapping innerType
+  static void Enable (std::string innerType = "ns3::MapScheduler");
+  static bool IsEnabled (void);
+
+  static void WriteFlat (std::ostream &os);
+  static bool WriteFolded (std::string fileName);
+
+  /// Cycles on x86, nanoseconds elsewhere
+  static uint64_t Ticks (void);
+  static void Account (const std::type_info &type, uint64_t ticks);
+
+private:
+  struct Entry
+  {
+    Entry () : ticks (0), count (0) {}
+    uint64_t ticks;
+    uint64_t count;
+  };
+  struct Target
+  {
+    std::string owner;
+    std::string name;
+    Entry       total;
+  };
+
+  /// Entries merged by demangled name, sorted by time
+  static void Collect (std::vector<Target> &targets);
+  static std::string Demangle (const char *name);
+  static double WallSeconds (void);
+  /// Seconds per tick, measured over the profiled run
+  static double TickSeconds (void);
+
+  static bool                                  s_enabled;
+  static std::map<const std::type_info *, Entry> s_entries;
+  static const std::type_info                  *s_lastType;
+  static Entry                                 *s_lastEntry;
+  static uint64_t                              s_startTicks;
+  static double                                s_startWall;
+};
+
+/*
+ * Scheduler that keeps the events in an inner scheduler and times the ones
+ * it returns from RemoveNext (), see EventProfiler.
+ */
+class ProfilingScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  ProfilingScheduler ();
+  virtual ~ProfilingScheduler ();
+
+  virtual void Insert (const Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Event PeekNext (void) const;
+  virtual Event RemoveNext (void);
+  virtual void Remove (const Event &ev);
+
+private:
+  /// Stands in for the real event while the simulator runs it
+  class TimedEvent : public EventImpl
+  {
+  public:
+    TimedEvent () : m_inner (0) {}
+    /// Release an event the simulator dropped without running it
+    void Release (void)
+    {
+      if (m_inner)
+        {
+          m_inner->Unref ();
+          m_inner = 0;
+        }
+    }
+    EventImpl *m_inner;
+  protected:
+    virtual void Notify (void)
+    {
+      if (!m_inner->IsCancelled ())
+        {
+          uint64_t start = EventProfiler::Ticks ();
+          m_inner->Invoke ();
+          EventProfiler::Account (typeid (*m_inner), EventProfiler::Ticks () - start);
+        }
+      Release ();
+    }
+  };
+
+  void SetInner (TypeId inner);
+
+  Ptr<Scheduler> m_inner;
+  TimedEvent    *m_timed;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (ProfilingScheduler);
+
+bool EventProfiler::s_enabled = false;
+std::map<const std::type_info *, EventProfiler::Entry> EventProfiler::s_entries;
+const std::type_info *EventProfiler::s_lastType = 0;
+EventProfiler::Entry *EventProfiler::s_lastEntry = 0;
+uint64_t EventProfiler::s_startTicks = 0;
+double EventProfiler::s_startWall = 0;
+
+TypeId
+ProfilingScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::ProfilingScheduler")
+    .SetParent (Scheduler::GetTypeId ())
+    .AddConstructor<ProfilingScheduler> ()
+    .AddAttribute ("Inner", "Scheduler that keeps the events",
+                   TypeIdValue (MapScheduler::GetTypeId ()),
+                   MakeTypeIdAccessor (&ProfilingScheduler::SetInner),
+                   MakeTypeIdChecker ())
+  ;
+  return tid;
+}
+
+ProfilingScheduler::ProfilingScheduler ()
+  : m_timed (new TimedEvent ())
+{
+}
+
+ProfilingScheduler::~ProfilingScheduler ()
+{
+  m_timed->Release ();
+  m_timed->Unref ();
+}
+
+void
+ProfilingScheduler::SetInner (TypeId inner)
+{
+  ObjectFactory factory;
+  factory.SetTypeId (inner);
+  m_inner = factory.Create<Scheduler> ();
+}
+
+void
+ProfilingScheduler::Insert (const Event &ev)
+{
+  m_inner->Insert (ev);
+}
+
+bool
+ProfilingScheduler::IsEmpty (void) const
+{
+  return m_inner->IsEmpty ();
+}
+
+Scheduler::Event
+ProfilingScheduler::PeekNext (void) const
+{
+  return m_inner->PeekNext ();
+}
+
+Scheduler::Event
+ProfilingScheduler::RemoveNext (void)
+{
+  Event ev = m_inner->RemoveNext ();
+  // The simulator runs the event once and unrefs it; the wrapper holds the
+  // reference to the real event until then
+  m_timed->Release ();
+  m_timed->m_inner = ev.impl;
+  m_timed->Ref ();
+  ev.impl = m_timed;
+  return ev;
+}
+
+void
+ProfilingScheduler::Remove (const Event &ev)
+{
+  m_inner->Remove (ev);
+}
+
+void
+EventProfiler::Enable (std::string innerType)
+{
+  ObjectFactory factory;
+  factory.SetTypeId ("ns3::ProfilingScheduler");
+  factory.Set ("Inner", TypeIdValue (TypeId::LookupByName (innerType)));
+  Simulator::SetScheduler (factory);
+  s_enabled = true;
+  s_startTicks = Ticks ();
+  s_startWall = WallSeconds ();
+}
+
+bool
+EventProfiler::IsEnabled (void)
+{
+  return s_enabled;
+}
+
+uint64_t
+EventProfiler::Ticks (void)
+{
+#if defined (__x86_64__) || defined (__i386__)
+  return __rdtsc ();
+#else
+  struct timespec ts;
+  clock_gettime (CLOCK_MONOTONIC, &ts);
+  return ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+#endif
+}
+
+void
+EventProfiler::Account (const std::type_info &type, uint64_t ticks)
+{
+  // Consecutive events very often have the same target
+  if (s_lastType != &type)
+    {
+      s_lastType = &type;
+      s_lastEntry = &s_entries[&type];
+    }
+  s_lastEntry->ticks += ticks;
+  s_lastEntry->count++;
+}
+
+double
+EventProfiler::WallSeconds (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+double
+EventProfiler::TickSeconds (void)
+{
+  uint64_t ticks = Ticks () - s_startTicks;
+  return ticks > 0 ? (WallSeconds () - s_startWall) / ticks : 0;
+}
+
+std::string
+EventProfiler::Demangle (const char *name)
+{
+  int status;
+  char *demangled = abi::__cxa_demangle (name, 0, 0, &status);
+  std::string result = status == 0 ? demangled : name;
+  std::free (demangled);
+  return result;
+}
+
+static bool
+EventProfilerMoreTime (const std::pair<uint64_t, uint32_t> &a, const std::pair<uint64_t, uint32_t> &b)
+{
+  return a.first > b.first;
+}
+
+void
+EventProfiler::Collect (std::vector<Target> &targets)
+{
+  std::map<std::string, uint32_t> index;
+  targets.clear ();
+  for (std::map<const std::type_info *, Entry>::const_iterator it = s_entries.begin (); it != s_entries.end (); ++it)
+    {
+      std::string name = Demangle (it->first->name ());
+      // MakeEvent<void (ns3::Class::*)(args), ...>(...)::EventMemberImplN: keep the function type
+      std::string::size_type start = name.find ("MakeEvent<");
+      if (start != std::string::npos)
+        {
+          start += 10;
+          int depth = 0;
+          std::string::size_type end = start;
+          while (end < name.size () && !(depth == 0 && (name[end] == ',' || name[end] == '>')))
+            {
+              depth += (name[end] == '<' || name[end] == '(') ? 1 : 0;
+              depth -= (name[end] == '>' || name[end] == ')') ? 1 : 0;
+              end++;
+            }
+          name = name.substr (start, end - start);
+        }
+      std::map<std::string, uint32_t>::iterator found = index.find (name);
+      if (found == index.end ())
+        {
+          Target target;
+          target.name = name;
+          // void (ns3::Class::*)(args) belongs to ns3::Class, free functions to themselves
+          std::string::size_type member = name.find ("::*)");
+          std::string::size_type open = member == std::string::npos ? member : name.rfind ('(', member);
+          target.owner = open == std::string::npos ? "(function)" : name.substr (open + 1, member - open - 1);
+          found = index.insert (std::make_pair (name, targets.size ())).first;
+          targets.push_back (target);
+        }
+      targets[found->second].total.ticks += it->second.ticks;
+      targets[found->second].total.count += it->second.count;
+    }
+
+  std::vector<std::pair<uint64_t, uint32_t> > order;
+  for (uint32_t i = 0; i < targets.size (); ++i)
+    {
+      order.push_back (std::make_pair (targets[i].total.ticks, i));
+    }
+  std::stable_sort (order.begin (), order.end (), EventProfilerMoreTime);
+  std::vector<Target> sorted;
+  for (uint32_t i = 0; i < order.size (); ++i)
+    {
+      sorted.push_back (targets[order[i].second]);
+    }
+  targets.swap (sorted);
+}
+
+void
+EventProfiler::WriteFlat (std::ostream &os)
+{
+  std::vector<Target> targets;
+  Collect (targets);
+  double tick = TickSeconds ();
+  uint64_t totalTicks = 0;
+  uint64_t totalCount = 0;
+  for (uint32_t i = 0; i < targets.size (); ++i)
+    {
+      totalTicks += targets[i].total.ticks;
+      totalCount += targets[i].total.count;
+    }
+
+  os << "Event profile: " << totalCount << " events, " << totalTicks * tick << " s in events\n";
+  os << "  %time   seconds     events   ns/event  target\n";
+  for (uint32_t i = 0; i < targets.size (); ++i)
+    {
+      const Entry &e = targets[i].total;
+      os << std::fixed << std::setprecision (2) << std::setw (7) << (totalTicks > 0 ? 100.0 * e.ticks / totalTicks : 0)
+         << std::setprecision (4) << std::setw (10) << e.ticks * tick
+         << std::setw (11) << e.count
+         << std::setprecision (0) << std::setw (11) << (e.count > 0 ? e.ticks * tick / e.count * 1e9 : 0)
+         << "  " << targets[i].name << "\n";
+    }
+  os.unsetf (std::ios::floatfield);
+  os << std::setprecision (6);
+}
+
+bool
+EventProfiler::WriteFolded (std::string fileName)
+{
+  std::ofstream out (fileName.c_str ());
+  if (!out)
+    {
+      std::cerr << "Error: Can't open " << fileName << "\n";
+      return false;
+    }
+  std::vector<Target> targets;
+  Collect (targets);
+  double tick = TickSeconds ();
+  for (uint32_t i = 0; i < targets.size (); ++i)
+    {
+      std::string name = targets[i].name;
+      std::replace (name.begin (), name.end (), ';', ',');
+      out << "Simulator::Run;" << targets[i].owner << ";" << name << " "
+          << static_cast<uint64_t> (targets[i].total.ticks * tick * 1e6) << "\n";
+    }
+  return out.good ();
+}
+
+#endif /* EVENT_PROFILER_H */
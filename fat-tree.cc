@@ -37,6 +37,8 @@
 #include "ns3/flow-monitor-helper.h"
 #include "ns3/ipv4-global-routing-helper.h"
 #include "ns3/csma-module.h"
+#include "bench-report.h"
+#include "ladder-scheduler.h"
 
 using namespace ns3;
 using namespace std;
@@ -84,8 +86,17 @@ main(int argc, char *argv[])
   //list.Add (olsr, 10);
 
   bool enableFlowMonitor = false;
+  std::string benchFile = "";
+  std::string scheduler = "map";
   cmd.AddValue("EnableMonitor", "Enable Flow Monitor", enableFlowMonitor);
+  cmd.AddValue("bench-file", "Write events and timings of this run as JSON, see scenario-bench", benchFile);
+  cmd.AddValue("scheduler", "Event scheduler: map, heap, list, calendar or ladder", scheduler);
   cmd.Parse(argc, argv);
+  BenchReport::Start (benchFile);
+  if (!SchedulerOption::Set (scheduler))
+    {
+      return 1;
+    }
 
   NS_LOG_INFO ("Create Nodes");
   NodeContainer c1,c2,c3,c4;
@@ -280,7 +291,9 @@ main(int argc, char *argv[])
   //
      NS_LOG_INFO ("Run Simulation.");
      Simulator::Stop (Seconds (20.0));
+     BenchReport::SetupDone ();
      Simulator::Run ();
+     BenchReport::Finish ();
      Simulator::Destroy ();
      NS_LOG_INFO ("Done.");
   //
@@ -0,0 +1,220 @@
+#ifndef FLOW_ENGINE_H
+#define FLOW_ENGINE_H
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <functional>
+#include <utility>
+#include <vector>
+
+using namespace ns3;
+
+/*
+ * FlowEngine drives many constant-rate flows from a single application.
+ *
+ * Instead of one MyApp (and one pending timer) per flow, all flows share one
+ * EventId and a min-heap of (next send time, flow index). Flow state is kept
+ * as a struct of arrays indexed by the flow number. Ties on the send time are
+ * broken by flow index, so the send order is deterministic.
+ *
+ * The sockets handed to AddFlow usually live on the node the engine is
+ * installed on; every send runs in that node's context.
+ */
+class FlowEngine : public Application
+{
+public:
+
+  FlowEngine ();
+  virtual ~FlowEngine();
+
+  /// Add a flow, nPackets == 0 sends until stop. Returns the flow index.
+  uint32_t AddFlow (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, DataRate dataRate, Time start, Time stop);
+  /// Preallocate the per-flow state for nFlows flows
+  void Reserve (uint32_t nFlows);
+  uint32_t GetNFlows (void) const;
+  uint64_t GetPacketsSent (void) const;
+
+private:
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+
+  void ScheduleTimer (void);
+  void OnTimer (void);
+
+  typedef std::pair<int64_t, uint32_t> HeapEntry;
+  typedef std::greater<HeapEntry> HeapCompare;
+
+  // Per-flow state, one entry per flow index
+  std::vector<Ptr<Socket> > m_sockets;
+  std::vector<Address>      m_peers;
+  std::vector<uint32_t>     m_packetSize;
+  std::vector<uint32_t>     m_nPackets;
+  std::vector<uint32_t>     m_packetsSent;
+  std::vector<int64_t>      m_gap;
+  std::vector<int64_t>      m_start;
+  std::vector<int64_t>      m_stop;
+  std::vector<bool>         m_closed;
+
+  std::vector<HeapEntry>    m_heap;
+  EventId                   m_timer;
+  bool                      m_running;
+  uint64_t                  m_totalSent;
+};
+
+FlowEngine::FlowEngine ()
+  : m_timer (),
+    m_running (false),
+    m_totalSent (0)
+{
+}
+
+FlowEngine::~FlowEngine()
+{
+  m_sockets.clear ();
+}
+
+uint32_t
+FlowEngine::AddFlow (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, DataRate dataRate, Time start, Time stop)
+{
+  uint32_t flow = m_sockets.size ();
+  uint64_t bitRate = dataRate.GetBitRate ();
+  uint64_t gapNs = bitRate > 0 ? static_cast<uint64_t> (packetSize) * 8 * 1000000000 / bitRate : 0;
+
+  m_sockets.push_back (socket);
+  m_peers.push_back (address);
+  m_packetSize.push_back (packetSize);
+  m_nPackets.push_back (nPackets);
+  m_packetsSent.push_back (0);
+  m_gap.push_back (std::max (NanoSeconds (gapNs).GetTimeStep (), static_cast<int64_t> (1)));
+  m_start.push_back (start.GetTimeStep ());
+  m_stop.push_back (stop.GetTimeStep ());
+  m_closed.push_back (false);
+
+  if (m_running)
+    {
+      int64_t first = std::max (m_start[flow], Simulator::Now ().GetTimeStep ());
+      m_heap.push_back (HeapEntry (first, flow));
+      std::push_heap (m_heap.begin (), m_heap.end (), HeapCompare ());
+      ScheduleTimer ();
+    }
+  return flow;
+}
+
+void
+FlowEngine::Reserve (uint32_t nFlows)
+{
+  m_sockets.reserve (nFlows);
+  m_peers.reserve (nFlows);
+  m_packetSize.reserve (nFlows);
+  m_nPackets.reserve (nFlows);
+  m_packetsSent.reserve (nFlows);
+  m_gap.reserve (nFlows);
+  m_start.reserve (nFlows);
+  m_stop.reserve (nFlows);
+  m_closed.reserve (nFlows);
+  m_heap.reserve (nFlows);
+}
+
+uint32_t
+FlowEngine::GetNFlows (void) const
+{
+  return m_sockets.size ();
+}
+
+uint64_t
+FlowEngine::GetPacketsSent (void) const
+{
+  return m_totalSent;
+}
+
+void
+FlowEngine::StartApplication (void)
+{
+  m_running = true;
+  m_heap.clear ();
+  int64_t now = Simulator::Now ().GetTimeStep ();
+  for (uint32_t flow = 0; flow < m_sockets.size (); ++flow)
+    {
+      m_packetsSent[flow] = 0;
+      m_closed[flow] = false;
+      m_heap.push_back (HeapEntry (std::max (m_start[flow], now), flow));
+    }
+  std::make_heap (m_heap.begin (), m_heap.end (), HeapCompare ());
+  ScheduleTimer ();
+}
+
+void
+FlowEngine::StopApplication (void)
+{
+  m_running = false;
+
+  if (m_timer.IsRunning ())
+    {
+      Simulator::Cancel (m_timer);
+    }
+
+  for (uint32_t flow = 0; flow < m_sockets.size (); ++flow)
+    {
+      if (m_packetsSent[flow] > 0 && !m_closed[flow])
+        {
+          m_sockets[flow]->Close ();
+        }
+    }
+  m_heap.clear ();
+}
+
+void
+FlowEngine::ScheduleTimer (void)
+{
+  if (m_timer.IsRunning ())
+    {
+      Simulator::Cancel (m_timer);
+    }
+  if (m_running && !m_heap.empty ())
+    {
+      Time delay = TimeStep (m_heap.front ().first - Simulator::Now ().GetTimeStep ());
+      m_timer = Simulator::Schedule (delay, &FlowEngine::OnTimer, this);
+    }
+}
+
+void
+FlowEngine::OnTimer (void)
+{
+  int64_t now = Simulator::Now ().GetTimeStep ();
+  while (!m_heap.empty () && m_heap.front ().first <= now)
+    {
+      std::pop_heap (m_heap.begin (), m_heap.end (), HeapCompare ());
+      HeapEntry entry = m_heap.back ();
+      m_heap.pop_back ();
+      uint32_t flow = entry.second;
+
+      if (entry.first >= m_stop[flow])
+        {
+          if (m_packetsSent[flow] > 0)
+            {
+              m_sockets[flow]->Close ();
+              m_closed[flow] = true;
+            }
+          continue;
+        }
+      if (m_packetsSent[flow] == 0)
+        {
+          m_sockets[flow]->Bind ();
+          m_sockets[flow]->Connect (m_peers[flow]);
+        }
+
+      m_sockets[flow]->Send (Create<Packet> (m_packetSize[flow]));
+      m_totalSent++;
+
+      if (++m_packetsSent[flow] < m_nPackets[flow] || m_nPackets[flow] == 0)
+        {
+          m_heap.push_back (HeapEntry (entry.first + m_gap[flow], flow));
+          std::push_heap (m_heap.begin (), m_heap.end (), HeapCompare ());
+        }
+    }
+  ScheduleTimer ();
+}
+
+#endif /* FLOW_ENGINE_H */
@@ -0,0 +1,371 @@
+#ifndef FLOW_MATRIX_H
+#define FLOW_MATRIX_H
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+
+#include "flow-engine.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+/*
+ * FlowMatrixHelper installs a whole traffic matrix read from a file, in place
+ * of one createTcpSocket/createUdpSocket call per flow.
+ *
+ * CSV layout, one flow per line ('#' lines and a non-numeric header line are
+ * ignored):
+ *
+ *   src,dst,proto,port,start,stop,rate,size
+ *   0,5,tcp,8080,1.0,100.0,250Kbps,1024
+ *
+ * src and dst index the NodeContainer / Ipv4InterfaceContainer given to
+ * Install, proto is tcp or udp, start and stop are in seconds, rate is an
+ * ns-3 DataRate string (or plain bit/s) and size the packet size in bytes.
+ *
+ * Binary layout, all integers little-endian:
+ *
+ *   header (16 bytes):  char magic[8] = "NS3FLOWS", uint32 version = 1, uint32 flow count
+ *   record (40 bytes):  uint32 src, uint32 dst, uint16 port, uint8 proto (6 or 17),
+ *                       uint8 reserved, uint32 size, uint64 rate (bit/s),
+ *                       uint64 start (ns), uint64 stop (ns)
+ *
+ * All flows leaving a node are driven by one FlowEngine on that node, and all
+ * flows to the same (node, proto, port) share one PacketSink.
+ */
+class FlowMatrixHelper
+{
+public:
+
+  FlowMatrixHelper ();
+
+  /// Load a flow matrix, binary if the file starts with the magic, CSV otherwise
+  bool Load (std::string fileName);
+  void AddFlow (uint32_t src, uint32_t dst, bool tcp, uint16_t port, Time start, Time stop, DataRate rate, uint32_t size);
+  /// Install every loaded flow, returns the FlowEngines and PacketSinks created
+  ApplicationContainer Install (const NodeContainer &nodes, const Ipv4InterfaceContainer &interfaces);
+
+  uint32_t GetNFlows (void) const;
+  uint32_t GetNSinks (void) const;
+  /// Wall time of the last Load and Install, in ms
+  int64_t GetLoadTime (void) const;
+  int64_t GetInstallTime (void) const;
+
+  static const uint32_t HEADER_SIZE = 16;
+  static const uint32_t RECORD_SIZE = 40;
+
+private:
+  bool LoadCsv (const std::string &fileName, const std::string &data);
+  bool LoadBinary (const std::string &fileName, const std::string &data);
+
+  static uint32_t ReadLe16 (const uint8_t *p);
+  static uint32_t ReadLe32 (const uint8_t *p);
+  static uint64_t ReadLe64 (const uint8_t *p);
+
+  // One entry per flow
+  std::vector<uint32_t> m_src;
+  std::vector<uint32_t> m_dst;
+  std::vector<bool>     m_tcp;
+  std::vector<uint16_t> m_port;
+  std::vector<int64_t>  m_start;
+  std::vector<int64_t>  m_stop;
+  std::vector<uint64_t> m_rate;
+  std::vector<uint32_t> m_size;
+
+  uint32_t m_nSinks;
+  int64_t  m_loadTime;
+  int64_t  m_installTime;
+};
+
+FlowMatrixHelper::FlowMatrixHelper ()
+  : m_nSinks (0),
+    m_loadTime (0),
+    m_installTime (0)
+{
+}
+
+uint32_t
+FlowMatrixHelper::ReadLe16 (const uint8_t *p)
+{
+  return static_cast<uint32_t> (p[0]) | (static_cast<uint32_t> (p[1]) << 8);
+}
+
+uint32_t
+FlowMatrixHelper::ReadLe32 (const uint8_t *p)
+{
+  return ReadLe16 (p) | (ReadLe16 (p + 2) << 16);
+}
+
+uint64_t
+FlowMatrixHelper::ReadLe64 (const uint8_t *p)
+{
+  return static_cast<uint64_t> (ReadLe32 (p)) | (static_cast<uint64_t> (ReadLe32 (p + 4)) << 32);
+}
+
+bool
+FlowMatrixHelper::Load (std::string fileName)
+{
+  SystemWallClockMs clock;
+  clock.Start ();
+
+  std::ifstream in (fileName.c_str (), std::ios::in | std::ios::binary);
+  if (!in)
+    {
+      std::cerr << "Error: Can't open flow matrix " << fileName << "\n";
+      return false;
+    }
+  std::ostringstream contents;
+  contents << in.rdbuf ();
+  const std::string &data = contents.str ();
+
+  bool ok;
+  if (data.size () >= HEADER_SIZE && data.compare (0, 8, "NS3FLOWS") == 0)
+    {
+      ok = LoadBinary (fileName, data);
+    }
+  else
+    {
+      ok = LoadCsv (fileName, data);
+    }
+  m_loadTime = clock.End ();
+  return ok;
+}
+
+bool
+FlowMatrixHelper::LoadBinary (const std::string &fileName, const std::string &data)
+{
+  const uint8_t *p = reinterpret_cast<const uint8_t *> (data.data ());
+  uint32_t count = ReadLe32 (p + 12);
+  if (ReadLe32 (p + 8) != 1 || data.size () < HEADER_SIZE + static_cast<uint64_t> (count) * RECORD_SIZE)
+    {
+      std::cerr << "Error: " << fileName << " is not a version 1 flow matrix\n";
+      return false;
+    }
+
+  uint32_t base = m_src.size ();
+  m_src.reserve (base + count);
+  m_dst.reserve (base + count);
+  m_tcp.reserve (base + count);
+  m_port.reserve (base + count);
+  m_start.reserve (base + count);
+  m_stop.reserve (base + count);
+  m_rate.reserve (base + count);
+  m_size.reserve (base + count);
+
+  const uint8_t *record = p + HEADER_SIZE;
+  for (uint32_t i = 0; i < count; ++i, record += RECORD_SIZE)
+    {
+      if (record[10] != 6 && record[10] != 17)
+        {
+          std::cerr << "Error: " << fileName << ": record " << i << ": expected proto 6 (tcp) or 17 (udp)\n";
+          return false;
+        }
+      m_src.push_back (ReadLe32 (record));
+      m_dst.push_back (ReadLe32 (record + 4));
+      m_port.push_back (ReadLe16 (record + 8));
+      m_tcp.push_back (record[10] == 6);
+      m_size.push_back (ReadLe32 (record + 12));
+      m_rate.push_back (ReadLe64 (record + 16));
+      m_start.push_back (NanoSeconds (ReadLe64 (record + 24)).GetTimeStep ());
+      m_stop.push_back (NanoSeconds (ReadLe64 (record + 32)).GetTimeStep ());
+    }
+  return true;
+}
+
+bool
+FlowMatrixHelper::LoadCsv (const std::string &fileName, const std::string &data)
+{
+  const char *p = data.c_str ();
+  uint32_t line = 0;
+  while (*p)
+    {
+      const char *end = std::strchr (p, '\n');
+      if (!end)
+        {
+          end = p + std::strlen (p);
+        }
+      line++;
+
+      // Comments, blank lines and a header line
+      if (*p < '0' || *p > '9')
+        {
+          p = *end ? end + 1 : end;
+          continue;
+        }
+
+      std::string fields[8];
+      uint32_t n = 0;
+      for (const char *f = p; n < 8 && f <= end; ++n)
+        {
+          const char *comma = f;
+          while (comma < end && *comma != ',')
+            {
+              comma++;
+            }
+          const char *last = comma;
+          while (last > f && (last[-1] == ' ' || last[-1] == '\r'))
+            {
+              last--;
+            }
+          while (f < last && *f == ' ')
+            {
+              f++;
+            }
+          fields[n].assign (f, last);
+          f = comma + 1;
+        }
+      if (n < 8 || (fields[2] != "tcp" && fields[2] != "udp"))
+        {
+          std::cerr << "Error: " << fileName << ":" << line << ": expected src,dst,tcp|udp,port,start,stop,rate,size\n";
+          return false;
+        }
+
+      const std::string &rate = fields[6];
+      uint64_t bitRate = rate.find_first_not_of ("0123456789") == std::string::npos
+        ? std::strtoull (rate.c_str (), 0, 10) : DataRate (rate).GetBitRate ();
+
+      AddFlow (std::strtoul (fields[0].c_str (), 0, 10), std::strtoul (fields[1].c_str (), 0, 10),
+               fields[2] == "tcp", std::strtoul (fields[3].c_str (), 0, 10),
+               Seconds (std::strtod (fields[4].c_str (), 0)), Seconds (std::strtod (fields[5].c_str (), 0)),
+               DataRate (bitRate), std::strtoul (fields[7].c_str (), 0, 10));
+      p = *end ? end + 1 : end;
+    }
+  return true;
+}
+
+void
+FlowMatrixHelper::AddFlow (uint32_t src, uint32_t dst, bool tcp, uint16_t port, Time start, Time stop, DataRate rate, uint32_t size)
+{
+  m_src.push_back (src);
+  m_dst.push_back (dst);
+  m_tcp.push_back (tcp);
+  m_port.push_back (port);
+  m_start.push_back (start.GetTimeStep ());
+  m_stop.push_back (stop.GetTimeStep ());
+  m_rate.push_back (rate.GetBitRate ());
+  m_size.push_back (size);
+}
+
+ApplicationContainer
+FlowMatrixHelper::Install (const NodeContainer &nodes, const Ipv4InterfaceContainer &interfaces)
+{
+  SystemWallClockMs clock;
+  clock.Start ();
+
+  ApplicationContainer apps;
+  std::vector<Ptr<FlowEngine> > engines (nodes.GetN ());
+  std::vector<int64_t> engineStop (nodes.GetN (), 0);
+  std::vector<uint32_t> flowsFrom (nodes.GetN (), 0);
+  // (node, proto, port) -> index into sinks
+  std::map<uint64_t, uint32_t> sinkIndex;
+  std::vector<Ptr<PacketSink> > sinks;
+  std::vector<int64_t> sinkStop;
+
+  for (uint32_t flow = 0; flow < m_src.size (); ++flow)
+    {
+      if (m_src[flow] >= nodes.GetN () || m_dst[flow] >= interfaces.GetN ())
+        {
+          std::cerr << "Error: Flow " << flow << " from node " << m_src[flow] << " to node " << m_dst[flow] << " is out of range, skipped\n";
+          continue;
+        }
+      flowsFrom[m_src[flow]]++;
+    }
+
+  ObjectFactory sinkFactory;
+  sinkFactory.SetTypeId ("ns3::PacketSink");
+  TypeId tcpFactory = TcpSocketFactory::GetTypeId ();
+  TypeId udpFactory = UdpSocketFactory::GetTypeId ();
+
+  for (uint32_t flow = 0; flow < m_src.size (); ++flow)
+    {
+      uint32_t src = m_src[flow];
+      uint32_t dst = m_dst[flow];
+      if (src >= nodes.GetN () || dst >= interfaces.GetN ())
+        {
+          continue;
+        }
+      TypeId factory = m_tcp[flow] ? tcpFactory : udpFactory;
+
+      uint64_t key = (static_cast<uint64_t> (dst) << 32) | (m_tcp[flow] ? 1 << 16 : 0) | m_port[flow];
+      std::map<uint64_t, uint32_t>::iterator it = sinkIndex.find (key);
+      if (it == sinkIndex.end ())
+        {
+          sinkFactory.Set ("Protocol", TypeIdValue (factory));
+          sinkFactory.Set ("Local", AddressValue (InetSocketAddress (Ipv4Address::GetAny (), m_port[flow])));
+          Ptr<PacketSink> sink = sinkFactory.Create<PacketSink> ();
+          nodes.Get (dst)->AddApplication (sink);
+          it = sinkIndex.insert (std::make_pair (key, static_cast<uint32_t> (sinks.size ()))).first;
+          sinks.push_back (sink);
+          sinkStop.push_back (0);
+        }
+      sinkStop[it->second] = std::max (sinkStop[it->second], m_stop[flow]);
+
+      if (!engines[src])
+        {
+          engines[src] = CreateObject<FlowEngine> ();
+          engines[src]->Reserve (flowsFrom[src]);
+          nodes.Get (src)->AddApplication (engines[src]);
+        }
+      engineStop[src] = std::max (engineStop[src], m_stop[flow]);
+
+      Ptr<Socket> socket = Socket::CreateSocket (nodes.Get (src), factory);
+      engines[src]->AddFlow (socket, InetSocketAddress (interfaces.GetAddress (dst), m_port[flow]), m_size[flow], 0,
+                             DataRate (m_rate[flow]), TimeStep (m_start[flow]), TimeStep (m_stop[flow]));
+    }
+
+  for (uint32_t i = 0; i < engines.size (); ++i)
+    {
+      if (engines[i])
+        {
+          engines[i]->SetStartTime (Seconds (0.));
+          engines[i]->SetStopTime (TimeStep (engineStop[i]));
+          apps.Add (engines[i]);
+        }
+    }
+  for (uint32_t i = 0; i < sinks.size (); ++i)
+    {
+      sinks[i]->SetStartTime (Seconds (0.));
+      sinks[i]->SetStopTime (TimeStep (sinkStop[i]));
+      apps.Add (sinks[i]);
+    }
+
+  m_nSinks = sinks.size ();
+  m_installTime = clock.End ();
+  return apps;
+}
+
+uint32_t
+FlowMatrixHelper::GetNFlows (void) const
+{
+  return m_src.size ();
+}
+
+uint32_t
+FlowMatrixHelper::GetNSinks (void) const
+{
+  return m_nSinks;
+}
+
+int64_t
+FlowMatrixHelper::GetLoadTime (void) const
+{
+  return m_loadTime;
+}
+
+int64_t
+FlowMatrixHelper::GetInstallTime (void) const
+{
+  return m_installTime;
+}
+
+#endif /* FLOW_MATRIX_H */
@@ -0,0 +1,176 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Aggregates the columnar per-run result files written by
+ * basev5-aodv_original --result-file.
+ *
+ * Every file in --dir ending in --suffix is mapped, and the chosen columns
+ * are summed per group of runs. Runs are grouped by the value of one run
+ * parameter (--group, e.g. mesh-width), or all together. For each group the
+ * run and flow counts, the per-flow mean of every column and the mean flow
+ * throughput are printed, tab separated.
+ *
+ *   ./waf --run "flow-results --dir=resultados --group=app-tx-rate"
+ */
+
+#include "ns3/core-module.h"
+#include "column-file.h"
+
+#include <dirent.h>
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("FlowResults");
+
+struct GroupTotals
+{
+  GroupTotals () : runs (0), flows (0), throughput (0), throughputFlows (0) {}
+  uint64_t runs;
+  uint64_t flows;
+  std::vector<double> sums;
+  double throughput;
+  uint64_t throughputFlows;
+};
+
+static std::vector<std::string>
+SplitColumns (std::string list)
+{
+  std::vector<std::string> columns;
+  std::istringstream in (list);
+  std::string name;
+  while (std::getline (in, name, ','))
+    {
+      if (!name.empty ())
+        {
+          columns.push_back (name);
+        }
+    }
+  return columns;
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string dir = "resultados";
+  std::string suffix = ".cols";
+  std::string group = "";
+  std::string columnList = "txBytes,rxBytes,txPackets,rxPackets,lostPackets";
+
+  CommandLine cmd;
+  cmd.AddValue ("dir", "Directory holding the run files", dir);
+  cmd.AddValue ("suffix", "Only read files ending with this", suffix);
+  cmd.AddValue ("group", "Run parameter to group the runs by, all runs together if empty", group);
+  cmd.AddValue ("columns", "Comma separated columns to aggregate", columnList);
+  cmd.Parse (argc, argv);
+
+  std::vector<std::string> columns = SplitColumns (columnList);
+  std::vector<std::string> files;
+  DIR *d = opendir (dir.c_str ());
+  if (!d)
+    {
+      std::cerr << "Error: Can't read directory " << dir << "\n";
+      return 1;
+    }
+  for (struct dirent *entry = readdir (d); entry; entry = readdir (d))
+    {
+      std::string name = entry->d_name;
+      if (name.size () >= suffix.size () && name.compare (name.size () - suffix.size (), suffix.size (), suffix) == 0)
+        {
+          files.push_back (dir + "/" + name);
+        }
+    }
+  closedir (d);
+  std::sort (files.begin (), files.end ());
+
+  SystemWallClockMs clock;
+  clock.Start ();
+
+  std::map<std::string, GroupTotals> groups;
+  uint32_t rejected = 0;
+  ColumnFileReader reader;
+  for (uint32_t f = 0; f < files.size (); ++f)
+    {
+      if (!reader.Open (files[f]))
+        {
+          rejected++;
+          continue;
+        }
+      GroupTotals &totals = groups[group.empty () ? "all" : reader.GetParameter (group)];
+      totals.sums.resize (columns.size (), 0);
+      totals.runs++;
+      totals.flows += reader.GetNRows ();
+
+      for (uint32_t c = 0; c < columns.size (); ++c)
+        {
+          int column = reader.FindColumn (columns[c]);
+          if (column < 0)
+            {
+              continue;
+            }
+          double sum = 0;
+          for (uint64_t row = 0; row < reader.GetNRows (); ++row)
+            {
+              sum += reader.GetValue (column, row);
+            }
+          totals.sums[c] += sum;
+        }
+
+      int rxBytes = reader.FindColumn ("rxBytes");
+      int firstTx = reader.FindColumn ("timeFirstTxPacket");
+      int lastRx = reader.FindColumn ("timeLastRxPacket");
+      if (rxBytes >= 0 && firstTx >= 0 && lastRx >= 0)
+        {
+          for (uint64_t row = 0; row < reader.GetNRows (); ++row)
+            {
+              double duration = reader.GetValue (lastRx, row) - reader.GetValue (firstTx, row);
+              if (duration > 0)
+                {
+                  totals.throughput += reader.GetValue (rxBytes, row) * 8.0 / duration / 1024;
+                  totals.throughputFlows++;
+                }
+            }
+        }
+    }
+  reader.Close ();
+  int64_t elapsed = clock.End ();
+
+  std::cout << (group.empty () ? "group" : group) << "\truns\tflows";
+  for (uint32_t c = 0; c < columns.size (); ++c)
+    {
+      std::cout << "\tmean " << columns[c];
+    }
+  std::cout << "\tmean throughput (Kbps)\n";
+  for (std::map<std::string, GroupTotals>::const_iterator it = groups.begin (); it != groups.end (); ++it)
+    {
+      const GroupTotals &totals = it->second;
+      std::cout << it->first << "\t" << totals.runs << "\t" << totals.flows;
+      for (uint32_t c = 0; c < columns.size (); ++c)
+        {
+          std::cout << "\t" << (totals.flows > 0 ? totals.sums[c] / totals.flows : 0);
+        }
+      std::cout << "\t" << (totals.throughputFlows > 0 ? totals.throughput / totals.throughputFlows : 0) << "\n";
+    }
+  std::cerr << files.size () - rejected << " run files read, " << rejected << " rejected, in " << elapsed << " ms\n";
+  return 0;
+}
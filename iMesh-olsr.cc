@@ -42,6 +42,7 @@
 #include "ns3/config.h"
 #include "ns3/names.h"
 #include "src/core/model/log.h"
+#include "rng-streams.h"
 
 using namespace ns3;
 
@@ -70,6 +71,9 @@ private:
   bool m_pcap;
   std::string m_stack;
   std::string m_root;
+  uint32_t m_run;
+  /// Fixed RNG streams, handed out in the order the scenario is built
+  RngStreams m_streams;
 
   NodeContainer nc_all; // Contains every node (starting with internet node, access nodes and then mesh nodes
   NodeContainer nc_mesh; // Contains mesh nodes
@@ -114,7 +118,8 @@ m_nIfaces (1),
 m_chan (true),
 m_pcap (false),
 m_stack ("ns3::Dot11sStack"),
-m_root ("ff:ff:ff:ff:ff:ff") { }
+m_root ("ff:ff:ff:ff:ff:ff"),
+m_run (0) { }
 
 void
 MeshTest::Configure (int argc, char *argv[])
@@ -137,7 +142,9 @@ MeshTest::Configure (int argc, char *argv[])
   cmd.AddValue ("stack", "Type of protocol stack. ns3::Dot11sStack by default", m_stack);
   cmd.AddValue ("root", "Mac address of root meshHelper point in HWMP", m_root);
 
+  cmd.AddValue ("run", "Replication number, each one draws from independent random substreams. [0: keep --RngRun]", m_run);
   cmd.Parse (argc, argv);
+  RngStreams::SetRun (m_run);
   NS_LOG_DEBUG ("Grid:" << m_xSize << "*" << m_ySize);
   NS_LOG_DEBUG ("Simulation time: " << m_totalTime << " s");
   
@@ -207,6 +214,7 @@ MeshTest::CreateNodes ()
   meshHelper.SetNumberOfInterfaces (m_nIfaces);
   // Install protocols and return container if MeshPointDevices
   meshDevices = meshHelper.Install (wifiPhy, nc_mesh);
+  m_streams.Assign (meshHelper, meshDevices);
   // Setup mobility - static grid topology
   MobilityHelper mobilityHelper;
   mobilityHelper.SetPositionAllocator ("ns3::GridPositionAllocator",
@@ -238,6 +246,8 @@ MeshTest::InstallInternetStack ()
 
   internetStackHelper.Install (nc_mesh);
   internetStackHelper.Install (nc_all.Get (0)); /// Setting up protocol stack on node 0
+  m_streams.Assign (internetStackHelper, NodeContainer::GetGlobal ());
+  m_streams.Assign (routingProtocol, NodeContainer::GetGlobal ());
 
   Ipv4AddressHelper meshAddress;
   meshAddress.SetBase ("10.1.1.0", "255.255.255.0");
@@ -323,6 +333,7 @@ MeshTest::Run ()
 
   Simulator::Schedule (Seconds (m_totalTime), &MeshTest::Report, this);
   Simulator::Stop (Seconds (m_totalTime));
+  m_streams.AssignNodes (NodeContainer::GetGlobal ());
   Simulator::Run ();
   Simulator::Destroy ();
 
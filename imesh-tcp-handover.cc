@@ -37,8 +37,12 @@
 #include "ns3/aodv-helper.h"
 #include "ns3/ipv4-global-routing-helper.h"
 #include "src/core/model/string.h"
-#include "mesh-tcp.h"
+#include "myapp.h"
+#include "rng-streams.h"
+#include "bench-report.h"
+#include "ladder-scheduler.h"
 
+#include <cstdlib>
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -52,25 +56,39 @@
 
 using namespace ns3;
 
-void
-createTcpSocket (NodeContainer c, Ipv4InterfaceContainer ifcont, int sink, int source, int sinkPort, double startTime, double stopTime, uint32_t packetSize, uint32_t numPackets, std::string dataRate)
+Ptr<MyApp>
+createTcpSocket (NodeContainer c, Ipv4InterfaceContainer ifcont, int sink, int source, int sinkPort, double startTime, double stopTime, uint32_t packetSize, uint32_t numPackets, std::string dataRate, Ptr<LatencySink> latencySink = 0)
 {
 
   // TCP connfection between mesh nodes
   Address sinkAddress1 (InetSocketAddress (ifcont.GetAddress (sink), sinkPort));
-  PacketSinkHelper packetSinkHelper1 ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), sinkPort));
-  ApplicationContainer sinkApps1 = packetSinkHelper1.Install (c.Get (sink));
-  sinkApps1.Start (Seconds (startTime));
-  sinkApps1.Stop (Seconds (stopTime));
+  if (latencySink)
+    {
+      // Stamped traffic goes to the latency sink instead of a PacketSink
+      latencySink->Setup (TcpSocketFactory::GetTypeId (), sinkPort, packetSize);
+      c.Get (sink)->AddApplication (latencySink);
+      latencySink->SetStartTime (Seconds (startTime));
+      latencySink->SetStopTime (Seconds (stopTime));
+    }
+  else
+    {
+      PacketSinkHelper packetSinkHelper1 ("ns3::TcpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), sinkPort));
+      ApplicationContainer sinkApps1 = packetSinkHelper1.Install (c.Get (sink));
+      sinkApps1.Start (Seconds (startTime));
+      sinkApps1.Stop (Seconds (stopTime));
+    }
 
   //// Create TCP application at nc_mesh(8) node
   Ptr<Socket> ns3TcpSocket1 = Socket::CreateSocket (c.Get (source), TcpSocketFactory::GetTypeId ());
   Ptr<MyApp> app1 = CreateObject<MyApp> ();
   app1->Setup (ns3TcpSocket1, sinkAddress1, packetSize, numPackets, DataRate (dataRate));
+  app1->SetBackpressure (true);
+  app1->SetStamping (latencySink != 0, 0);
   c.Get (source)->AddApplication (app1);
   app1->SetStartTime (Seconds (startTime));
   app1->SetStopTime (Seconds (stopTime));
 
+  return app1;
 }
 
 void
@@ -87,6 +105,13 @@ setPhy (YansWifiPhyHelper &wifiPhy)
 
 NS_LOG_COMPONENT_DEFINE ("iMesh-tcp-handover");
 
+static void
+ReportLatencyWindow (Ptr<LatencySink> sink)
+{
+  sink->Report (std::cout);
+  sink->ResetWindow ();
+}
+
 static void
 SetPosition (Ptr<Node> node, double x, double y)
 {
@@ -118,8 +143,14 @@ private:
   uint32_t m_nIfaces;
   bool m_chan;
   bool m_pcap;
+  bool m_latency;
   std::string m_stack;
   std::string m_root;
+  uint32_t m_run;
+  std::string m_benchFile;
+  std::string m_scheduler;
+  /// Fixed RNG streams, handed out in the order the scenario is built
+  RngStreams m_streams;
 
   NodeContainer nc_all; // Contains every node (starting with internet node, access nodes and then mesh nodes
   NodeContainer nc_mesh; // Contains mesh nodes
@@ -141,6 +172,11 @@ private:
 
   MobilityHelper mobility;
 
+  /// TCP source, kept to report the bytes its socket accepted
+  Ptr<MyApp> m_tcpApp;
+  /// Sink of the TCP flow when in-band latency measurement is enabled
+  Ptr<LatencySink> m_latencySink;
+
 private:
   /// Create nodes and setup their mobility
   void CreateNodes ();
@@ -165,8 +201,12 @@ m_packetSize (1024),
 m_nIfaces (1),
 m_chan (true),
 m_pcap (true),
+m_latency (false),
 m_stack ("ns3::Dot11sStack"),
-m_root ("ff:ff:ff:ff:ff:ff") { }
+m_root ("ff:ff:ff:ff:ff:ff"),
+m_run (0),
+m_benchFile (""),
+m_scheduler ("map") { }
 
 void
 MeshTest::Configure (int argc, char *argv[])
@@ -188,8 +228,18 @@ MeshTest::Configure (int argc, char *argv[])
   cmd.AddValue ("pcap", "Enable PCAP traces on meshInterfaces. [0]", m_pcap);
   cmd.AddValue ("stack", "Type of protocol stack. ns3::Dot11sStack by default", m_stack);
   cmd.AddValue ("root", "Mac address of root meshHelper point in HWMP", m_root);
+  cmd.AddValue ("latency", "Stamp TCP packets and report p50/p99/p999 one-way latency around the handover. [0]", m_latency);
 
+  cmd.AddValue ("run", "Replication number, each one draws from independent random substreams. [0: keep --RngRun]", m_run);
+  cmd.AddValue ("bench-file", "Write events and timings of this run as JSON, see scenario-bench. [none]", m_benchFile);
+  cmd.AddValue ("scheduler", "Event scheduler: map, heap, list, calendar or ladder. [map]", m_scheduler);
   cmd.Parse (argc, argv);
+  BenchReport::Start (m_benchFile);
+  if (!SchedulerOption::Set (m_scheduler))
+    {
+      std::exit (1);
+    }
+  RngStreams::SetRun (m_run);
   NS_LOG_DEBUG ("Grid:" << m_xSize << "*" << m_ySize);
   NS_LOG_DEBUG ("Simulation time: " << m_totalTime << " s");
 
@@ -304,6 +354,7 @@ MeshTest::CreateNodes ()
   meshHelper.SetNumberOfInterfaces (m_nIfaces);
   // Install protocols and return container if MeshPointDevices
   meshDevices = meshHelper.Install (wifiPhy, nc_mesh);
+  m_streams.Assign (meshHelper, meshDevices);
   // Setup mobility - static grid topology
 
 #if 0
@@ -368,6 +419,8 @@ MeshTest::InstallInternetStack ()
   
   internetStackHelper.Install (nc_mesh);
   internetStackHelper.Install (nc_all.Get (0)); /// Setting up protocol stack on node 0
+  m_streams.Assign (internetStackHelper, NodeContainer::GetGlobal ());
+  m_streams.Assign (routingProtocol, NodeContainer::GetGlobal ());
 
   Ipv4AddressHelper meshAddress;
   meshAddress.SetBase ("10.1.1.0", "255.255.255.0");
@@ -379,7 +432,11 @@ MeshTest::InstallInternetStack ()
   
     //-----------------------------------CREATE A TCP SOCKET
 
-  createTcpSocket (nc_mesh, meshInterfaces, 0, 8, 8080, 1.0, 100.0, m_packetSize, 100, "1Mbps");
+  if (m_latency)
+    {
+      m_latencySink = CreateObject<LatencySink> ();
+    }
+  m_tcpApp = createTcpSocket (nc_mesh, meshInterfaces, 0, 8, 8080, 1.0, 100.0, m_packetSize, 100, "1Mbps", m_latencySink);
 
   //createTcpSocket (nc_internet, p2pInterfaces, 1, 0, 8080, 1.0, 100.0, m_packetSize, 1000, "250Kbps");
 
@@ -459,6 +516,11 @@ MeshTest::Run ()
   mobility.Install (nc_all);
 
   Simulator::Schedule (Seconds (12.0), &SetPosition, nc_mesh.Get (m_xSize * m_ySize - 1), 37.0, 75.0);
+  if (m_latencySink)
+    {
+      // Report the latency seen before the handover, then measure after it separately
+      Simulator::Schedule (Seconds (12.0), &ReportLatencyWindow, m_latencySink);
+    }
 
   Simulator::Stop (Seconds (m_totalTime));
   AnimationInterface animation ("iMesh-tcp-handover.xml");
@@ -488,7 +550,22 @@ MeshTest::Run ()
 
   //Simulator::Schedule (Seconds (m_totalTime), &MeshTest::Report, this);
   //Simulator::Stop (Seconds (m_totalTime));
+  m_streams.AssignNodes (NodeContainer::GetGlobal ());
+  BenchReport::SetupDone ();
   Simulator::Run ();
+  BenchReport::Finish ();
+
+  const std::vector<uint64_t> &accepted = m_tcpApp->GetAcceptedPerSecond ();
+  for (uint32_t i = 0; i < accepted.size (); ++i)
+    {
+      std::cout << "Second " << i + 1 << " accepted " << accepted[i] << " bytes\n";
+    }
+  std::cout << "Total accepted: " << m_tcpApp->GetBytesAccepted () << " bytes\n";
+  if (m_latencySink)
+    {
+      m_latencySink->Report (std::cout);
+    }
+
   Simulator::Destroy ();
 
   return 0;
@@ -16,6 +16,8 @@
 #include "ns3/mobility-module.h"
 #include "ns3/mesh-helper.h"
 #include "ns3/flow-monitor-module.h"
+#include <cmath>
+#include <cstdlib>
 #include <iomanip>
 #include <string>
 #include <iostream>
@@ -30,6 +32,13 @@
 #include "ns3/ipv4-global-routing-helper.h"
 #include "ns3/netanim-module.h"
 #include "src/network/model/packet-metadata.h"
+#include "throughput-sampler.h"
+#include "time-series-store.h"
+#include "rng-streams.h"
+#include "bench-report.h"
+#include "event-profiler.h"
+#include "ladder-scheduler.h"
+#include "loss-cache.h"
 //#include "mesh.h"
 
 #include <iostream>
@@ -38,7 +47,8 @@
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("infrastructure-mesh");
-void ThroughputMonitor (FlowMonitorHelper *fmhelper, Ptr<FlowMonitor> flowMon, Gnuplot2dDataset DataSet);
+void ThroughputMonitor (ThroughputSampler *sampler, TimeSeriesStore *series);
+void DumpFlowXml (Ptr<FlowMonitor> flowMon, std::string fileName, Time interval);
 // Method for setting mobility using (x,y) position for the nodes
 
 static void
@@ -76,10 +86,25 @@ private:
   uint32_t m_nIfaces;
   bool m_chan;
   bool m_pcap;
+  std::string m_statsFile;
+  bool m_statsBinary;
+  bool m_statsAsync;
+  double m_xmlInterval;
+  bool m_seriesBinary;
   std::string m_stack;
   std::string m_phyMode;
   std::string m_rate;
   std::string m_root;
+  uint32_t m_run;
+  std::string m_benchFile;
+  std::string m_profileFile;
+  std::string m_scheduler;
+  bool m_lossCache;
+  /// Fixed RNG streams, handed out in the order the scenario is built
+  RngStreams m_streams;
+  /// The one channel of both meshes, BSSs and STAs
+  Ptr<YansWifiChannel> m_channel;
+  Ptr<CachedPropagationLossModel> m_cache;
 
   /// NodeContainer for individual nodes
   NodeContainer nc_sta1, nc_sta2;
@@ -177,10 +202,20 @@ m_packetSize (1024),
 m_nIfaces (1),
 m_chan (true),
 m_pcap (false),
+m_statsFile (""),
+m_statsBinary (false),
+m_statsAsync (false),
+m_xmlInterval (0),
+m_seriesBinary (false),
 m_stack ("ns3::Dot11sStack"),
 m_phyMode ("DsssRate1Mbps"),
 m_rate ("8kbps"),
-m_root ("ff:ff:ff:ff:ff:ff") { }
+m_root ("ff:ff:ff:ff:ff:ff"),
+m_run (0),
+m_benchFile (""),
+m_profileFile (""),
+m_scheduler ("map"),
+m_lossCache (false) { }
 
 void
 MeshTest::Configure (int argc, char *argv[])
@@ -203,8 +238,28 @@ MeshTest::Configure (int argc, char *argv[])
   cmd.AddValue ("pcap", "Enable PCAP traces on interfaces. [0]", m_pcap);
   cmd.AddValue ("stack", "Type of protocol stack. ns3::Dot11sStack by default", m_stack);
   cmd.AddValue ("root", "Mac address of root mesh point in HWMP", m_root);
-
+  cmd.AddValue ("stats-file", "Append per-second flow statistics to this file while running. [none]", m_statsFile);
+  cmd.AddValue ("stats-binary", "Write the stats file as binary records instead of text. [0]", m_statsBinary);
+  cmd.AddValue ("stats-async", "Write the stats file from a background thread. [0]", m_statsAsync);
+  cmd.AddValue ("xml-interval", "Also dump the FlowMonitor XML every this many seconds, 0 dumps it once at the end. [0]", m_xmlInterval);
+  cmd.AddValue ("series-binary", "Write the per-flow throughput series as binary instead of CSV. [0]", m_seriesBinary);
+
+  cmd.AddValue ("run", "Replication number, each one draws from independent random substreams. [0: keep --RngRun]", m_run);
+  cmd.AddValue ("bench-file", "Write events and timings of this run as JSON, see scenario-bench. [none]", m_benchFile);
+  cmd.AddValue ("profile", "Profile time per event target, print it and write folded stacks for flame graphs to this file. [none]", m_profileFile);
+  cmd.AddValue ("scheduler", "Event scheduler: map, heap, list, calendar or ladder. [map]", m_scheduler);
+  cmd.AddValue ("loss-cache", "Cache the received power between fixed nodes and print the hit rate. [0]", m_lossCache);
   cmd.Parse (argc, argv);
+  BenchReport::Start (m_benchFile);
+  if (!SchedulerOption::Set (m_scheduler))
+    {
+      std::exit (1);
+    }
+  if (!m_profileFile.empty ())
+    {
+      EventProfiler::Enable (SchedulerOption::GetTypeName (m_scheduler));
+    }
+  RngStreams::SetRun (m_run);
   //NS_LOG_DEBUG("Grid:" << m_xSize << "*" << m_ySize);
   //NS_LOG_DEBUG("Simulation time: " << m_totalTime << " s");
   Config::SetDefault ("ns3::OnOffApplication::DataRate",
@@ -262,7 +317,8 @@ MeshTest::CreateNodes ()
   // Configure YansWifiChannel
   YansWifiPhyHelper wifiPhy = YansWifiPhyHelper::Default ();
   YansWifiChannelHelper wifiChannel = YansWifiChannelHelper::Default ();
-  wifiPhy.SetChannel (wifiChannel.Create ());
+  m_channel = wifiChannel.Create ();
+  wifiPhy.SetChannel (m_channel);
 
   //------------------------ mesh router1 -----------------------------------
   /*
@@ -375,6 +431,10 @@ MeshTest::CreateNodes ()
                 "Ssid", SsidValue (ssid2));
 
   de_ap2 = wifi2.Install (wifiPhy, mac2, nc_ap2);
+  m_streams.Assign (meshHelper1, de_mesh1);
+  m_streams.Assign (meshHelper2, de_mesh2);
+  m_streams.Assign (wifi1, NetDeviceContainer (de_sta1, de_ap1));
+  m_streams.Assign (wifi2, NetDeviceContainer (de_sta2, de_ap2));
 
   // Net Device container for STA and AP in network 1
   de_wifi_sta1Ap1.Add (de_sta1);
@@ -522,6 +582,8 @@ MeshTest::InstallInternetStack ()
   internetStackHelper.Install (nc_gw1);
   internetStackHelper.Install (nc_gw2);
   internetStackHelper.Install (nc_bb1);
+  m_streams.Assign (internetStackHelper, NodeContainer::GetGlobal ());
+  m_streams.Assign (routingProtocol, NodeContainer::GetGlobal ());
 
   // Network 1 (left)
   address.SetBase ("10.1.1.0", "255.255.255.0");
@@ -580,6 +642,10 @@ MeshTest::Run ()
   InstallInternetStack ();
   SetupMobility ();
   InstallApplication ();
+  if (m_lossCache)
+    {
+      m_cache = LossCache::Install (m_channel);
+    }
 
   //Gnuplot parameters
 
@@ -587,7 +653,6 @@ MeshTest::Run ()
   std::string graphicsFileName = fileNameWithNoExtension + ".png";
   std::string plotFileName = fileNameWithNoExtension + ".plt";
   std::string plotTitle = "Flow vs Throughput";
-  std::string dataTitle = "Throughput";
 
   // Instantiate the plot and set its title.
   Gnuplot gnuplot (graphicsFileName);
@@ -598,18 +663,27 @@ MeshTest::Run ()
   gnuplot.SetTerminal ("png");
 
   // Set the labels for each axis.
-  gnuplot.SetLegend ("Flow", "Throughput");
+  gnuplot.SetLegend ("Time (s)", "Throughput (Mbps)");
 
-
-  Gnuplot2dDataset dataset;
-  dataset.SetTitle (dataTitle);
-  dataset.SetStyle (Gnuplot2dDataset::LINES_POINTS);
+  // Per-flow throughput, at most 512 buckets per flow whatever the run length
+  TimeSeriesStore series (512, Seconds (std::max (1.0, std::ceil (m_totalTime / 512))));
 
   //flowMonitor declaration
   FlowMonitorHelper fmHelper;
   Ptr<FlowMonitor> allMon = fmHelper.InstallAll ();
+  // Sample per-second throughput deltas, room for 256 flows over the whole run
+  ThroughputSampler sampler (allMon, 256, 256 * (static_cast<uint32_t> (m_totalTime) + 1));
+  StatsStream statsStream;
+  if (!m_statsFile.empty () && statsStream.Open (m_statsFile, m_statsBinary, 1024 * 1024, m_statsAsync))
+    {
+      sampler.SetStream (&statsStream);
+    }
   // call the flow monitor function
-  ThroughputMonitor (&fmHelper, allMon, dataset);
+  ThroughputMonitor (&sampler, &series);
+  if (m_xmlInterval > 0)
+    {
+      Simulator::Schedule (Seconds (m_xmlInterval), &DumpFlowXml, allMon, "infrastructure-mesh-backbone-throughputMonitor.xml", Seconds (m_xmlInterval));
+    }
 
 
   Simulator::Stop (Seconds (m_totalTime));
@@ -617,15 +691,39 @@ MeshTest::Run ()
   AnimationInterface animation ("iMesh-murad.xml");
   animation.EnablePacketMetadata (false);
 
+  m_streams.AssignNodes (NodeContainer::GetGlobal ());
+  BenchReport::SetupDone ();
   Simulator::Run ();
+  BenchReport::Finish ();
+  if (m_cache)
+    {
+      m_cache->PrintStats (std::cout);
+    }
+  if (EventProfiler::IsEnabled ())
+    {
+      EventProfiler::WriteFlat (std::cout);
+      EventProfiler::WriteFolded (m_profileFile);
+    }
+  statsStream.Close ();
+  allMon->SerializeToXmlFile ("infrastructure-mesh-backbone-throughputMonitor.xml", true, true);
+  sampler.Report (std::cout, DynamicCast<Ipv4FlowClassifier> (fmHelper.GetClassifier ()));
   //Gnuplot ...continued
-  gnuplot.AddDataset (dataset);
+  series.AddToPlot (gnuplot, "Flow ");
   // Open the plot file.
   std::ofstream plotFile (plotFileName.c_str ());
   // Write the plot file.
   gnuplot.GenerateOutput (plotFile);
   // Close the plot file.
   plotFile.close ();
+  if (m_seriesBinary)
+    {
+      series.WriteBinary (fileNameWithNoExtension + ".bin");
+    }
+  else
+    {
+      std::ofstream seriesFile ((fileNameWithNoExtension + ".csv").c_str ());
+      series.WriteCsv (seriesFile);
+    }
   Simulator::Destroy ();
 
   return 0;
@@ -643,30 +741,20 @@ main (int argc, char *argv[])
 }
 
 void
-ThroughputMonitor (FlowMonitorHelper *fmhelper, Ptr<FlowMonitor> flowMon, Gnuplot2dDataset DataSet)
+ThroughputMonitor (ThroughputSampler *sampler, TimeSeriesStore *series)
 {
-  double localThrou = 0;
-  std::map<FlowId, FlowMonitor::FlowStats> flowStats = flowMon->GetFlowStats ();
-  Ptr<Ipv4FlowClassifier> classing = DynamicCast<Ipv4FlowClassifier> (fmhelper->GetClassifier ());
-  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator stats = flowStats.begin (); stats != flowStats.end (); ++stats)
+  uint32_t first = sampler->GetNRows ();
+  sampler->Sample ();
+  for (uint32_t row = first; row < sampler->GetNRows (); ++row)
     {
-      Ipv4FlowClassifier::FiveTuple fiveTuple = classing->FindFlow (stats->first);
-      std::cout << "Flow ID     : " << stats->first << " ; " << fiveTuple.sourceAddress << " -----> " << fiveTuple.destinationAddress << std::endl;
-      std::cout << "Tx Packets = " << stats->second.txPackets << std::endl;
-      std::cout << "Rx Packets = " << stats->second.rxPackets << std::endl;
-      std::cout << "Duration    : " << (stats->second.timeLastRxPacket.GetSeconds () - stats->second.timeFirstTxPacket.GetSeconds ()) << std::endl;
-      std::cout << "Last Received Packet  : " << stats->second.timeLastRxPacket.GetSeconds () << " Seconds" << std::endl;
-      std::cout << "Throughput: " << stats->second.rxBytes * 8.0 / (stats->second.timeLastRxPacket.GetSeconds () - stats->second.timeFirstTxPacket.GetSeconds ()) / 1024 / 1024 << " Mbps" << std::endl;
-      localThrou = (stats->second.rxBytes * 8.0 / (stats->second.timeLastRxPacket.GetSeconds () - stats->second.timeFirstTxPacket.GetSeconds ()) / 1024 / 1024);
-      // updata gnuplot data
-      DataSet.Add ((double) Simulator::Now ().GetSeconds (), (double) localThrou);
-      std::cout << "---------------------------------------------------------------------------" << std::endl;
+      series->Add (sampler->GetFlowId (row), sampler->GetTime (row), sampler->GetThroughput (row));
     }
-  Simulator::Schedule (Seconds (1), &ThroughputMonitor, fmhelper, flowMon, DataSet);
-  //if(flowToXml)
-  {
-    flowMon->SerializeToXmlFile ("infrastructure-mesh-backbone-throughputMonitor.xml", true, true);
-  }
-
+  Simulator::Schedule (Seconds (1), &ThroughputMonitor, sampler, series);
 }
 
+void
+DumpFlowXml (Ptr<FlowMonitor> flowMon, std::string fileName, Time interval)
+{
+  flowMon->SerializeToXmlFile (fileName, true, true);
+  Simulator::Schedule (interval, &DumpFlowXml, flowMon, fileName, interval);
+}
@@ -22,7 +22,8 @@
 #include "ns3/ipv4-global-routing-helper.h"
 #include "ns3/netanim-module.h"
 #include "src/network/model/packet-metadata.h"
-#include "mesh-tcp.h"
+#include "myapp.h"
+#include "rng-streams.h"
 
 #include <iostream>
 #include <sstream>
@@ -69,6 +70,9 @@ private:
   bool m_pcap;
   std::string m_stack;
   std::string m_root;
+  uint32_t m_run;
+  /// Fixed RNG streams, handed out in the order the scenario is built
+  RngStreams m_streams;
 
   /// NodeContainer for individual nodes
   NodeContainer nc_sta1, nc_sta2;
@@ -154,7 +158,8 @@ m_nIfaces (1),
 m_chan (true),
 m_pcap (false),
 m_stack ("ns3::Dot11sStack"),
-m_root ("ff:ff:ff:ff:ff:ff") { }
+m_root ("ff:ff:ff:ff:ff:ff"),
+m_run (0) { }
 
 void
 MeshTest::Configure (int argc, char *argv[])
@@ -175,7 +180,9 @@ MeshTest::Configure (int argc, char *argv[])
   cmd.AddValue ("stack", "Type of protocol stack. ns3::Dot11sStack by default", m_stack);
   cmd.AddValue ("root", "Mac address of root mesh point in HWMP", m_root);
 
+  cmd.AddValue ("run", "Replication number, each one draws from independent random substreams. [0: keep --RngRun]", m_run);
   cmd.Parse (argc, argv);
+  RngStreams::SetRun (m_run);
 }
 
 void
@@ -304,6 +311,9 @@ MeshTest::CreateNodes ()
                 "Ssid", SsidValue (ssid2));
 
   de_ap2 = wifi2.Install (wifiPhy, mac2, nc_ap2);
+  m_streams.Assign (meshHelper, NetDeviceContainer (de_mesh_mr1Gw1, de_mesh_mr2Gw2));
+  m_streams.Assign (wifi1, NetDeviceContainer (NetDeviceContainer (de_sta1, de_ap1), de_ap3));
+  m_streams.Assign (wifi2, NetDeviceContainer (de_sta2, de_ap2));
 
   // Setup WiFi for network 3
   WifiHelper wifi3 = WifiHelper::Default ();
@@ -384,6 +394,8 @@ MeshTest::InstallInternetStack ()
   internetStackHelper.Install (nc_gw1);
   internetStackHelper.Install (nc_gw2);
   internetStackHelper.Install (nc_bb1);
+  m_streams.Assign (internetStackHelper, NodeContainer::GetGlobal ());
+  m_streams.Assign (routingProtocol, NodeContainer::GetGlobal ());
 
   // -------------------- IP address for Network 1 (left)---------------------------
   address.SetBase ("10.1.1.0", "255.255.255.0");
@@ -448,6 +460,7 @@ MeshTest::Run ()
   AnimationInterface animation ("infrastructure-mesh.xml");
   animation.EnablePacketMetadata (false);
 
+  m_streams.AssignNodes (NodeContainer::GetGlobal ());
   Simulator::Run ();
   Simulator::Destroy ();
 
@@ -68,124 +68,27 @@
 #include "ns3/internet-module.h"
 #include "ns3/flow-monitor-module.h"
 #include "ns3/ipv4-global-routing-helper.h"
+#include "myapp.h"
+#include "async-writer.h"
+#include "bench-report.h"
+#include "ladder-scheduler.h"
 
 using namespace ns3;
 
 NS_LOG_COMPONENT_DEFINE ("Lab2");
 
-class MyApp : public Application
-{
-public:
-
-  MyApp ();
-  virtual ~MyApp();
-
-  void Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, DataRate dataRate);
-  void ChangeRate(DataRate newrate);
-
-private:
-  virtual void StartApplication (void);
-  virtual void StopApplication (void);
-
-  void ScheduleTx (void);
-  void SendPacket (void);
-
-  Ptr<Socket>     m_socket;
-  Address         m_peer;
-  uint32_t        m_packetSize;
-  uint32_t        m_nPackets;
-  DataRate        m_dataRate;
-  EventId         m_sendEvent;
-  bool            m_running;
-  uint32_t        m_packetsSent;
-};
-
-MyApp::MyApp ()
-  : m_socket (0),
-    m_peer (),
-    m_packetSize (0),
-    m_nPackets (0),
-    m_dataRate (0),
-    m_sendEvent (),
-    m_running (false),
-    m_packetsSent (0)
-{
-}
-
-MyApp::~MyApp()
-{
-  m_socket = 0;
-}
-
-void
-MyApp::Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, DataRate dataRate)
-{
-  m_socket = socket;
-  m_peer = address;
-  m_packetSize = packetSize;
-  m_nPackets = nPackets;
-  m_dataRate = dataRate;
-}
-
-void
-MyApp::StartApplication (void)
-{
-  m_running = true;
-  m_packetsSent = 0;
-  m_socket->Bind ();
-  m_socket->Connect (m_peer);
-  SendPacket ();
-}
-
-void
-MyApp::StopApplication (void)
-{
-  m_running = false;
-
-  if (m_sendEvent.IsRunning ())
-    {
-      Simulator::Cancel (m_sendEvent);
-    }
-
-  if (m_socket)
-    {
-      m_socket->Close ();
-    }
-}
-
-void
-MyApp::SendPacket (void)
-{
-  Ptr<Packet> packet = Create<Packet> (m_packetSize);
-  m_socket->Send (packet);
-
-  if (++m_packetsSent < m_nPackets)
-    {
-      ScheduleTx ();
-    }
-}
-
-void
-MyApp::ScheduleTx (void)
-{
-  if (m_running)
-    {
-      Time tNext (Seconds (m_packetSize * 8 / static_cast<double> (m_dataRate.GetBitRate ())));
-      m_sendEvent = Simulator::Schedule (tNext, &MyApp::SendPacket, this);
-    }
-}
-
-void
-MyApp::ChangeRate(DataRate newrate)
+static void
+CwndChange (uint32_t oldCwnd, uint32_t newCwnd)
 {
-   m_dataRate = newrate;
-   return;
+  std::cout << Simulator::Now ().GetSeconds () << "\t" << newCwnd <<"\n";
 }
 
 static void
-CwndChange (uint32_t oldCwnd, uint32_t newCwnd)
+CwndChangeAsync (AsyncWriter *writer, uint32_t oldCwnd, uint32_t newCwnd)
 {
-  std::cout << Simulator::Now ().GetSeconds () << "\t" << newCwnd <<"\n";
+  char line[64];
+  int length = snprintf (line, sizeof (line), "%g\t%u\n", Simulator::Now ().GetSeconds (), newCwnd);
+  writer->WriteWait (line, length);
 }
 
 void
@@ -201,14 +104,27 @@ int main (int argc, char *argv[])
   std::string lat = "2ms";
   std::string rate = "500kb/s"; // P2P link
   bool enableFlowMonitor = false;
+  uint32_t burstSize = 1;
+  std::string cwndFile = "";
+  std::string benchFile = "";
+  std::string scheduler = "map";
 
 
   CommandLine cmd;
   cmd.AddValue ("latency", "P2P link Latency in miliseconds", lat);
   cmd.AddValue ("rate", "P2P data rate in bps", rate);
   cmd.AddValue ("EnableMonitor", "Enable Flow Monitor", enableFlowMonitor);
+  cmd.AddValue ("burst", "Packets sent per application transmit event", burstSize);
+  cmd.AddValue ("cwndFile", "Write the cwnd trace to this file from a background thread instead of stdout", cwndFile);
+  cmd.AddValue ("bench-file", "Write events and timings of this run as JSON, see scenario-bench", benchFile);
+  cmd.AddValue ("scheduler", "Event scheduler: map, heap, list, calendar or ladder", scheduler);
 
   cmd.Parse (argc, argv);
+  BenchReport::Start (benchFile);
+  if (!SchedulerOption::Set (scheduler))
+    {
+      return 1;
+    }
 
 //
 // Explicitly create the nodes required by the topology (shown above).
@@ -279,11 +195,20 @@ int main (int argc, char *argv[])
   Ptr<Socket> ns3TcpSocket = Socket::CreateSocket (c.Get (0), TcpSocketFactory::GetTypeId ()); //source at n0
 
   // Trace Congestion window
-  ns3TcpSocket->TraceConnectWithoutContext ("CongestionWindow", MakeCallback (&CwndChange));
+  AsyncWriter cwndWriter;
+  if (!cwndFile.empty () && cwndWriter.Open (cwndFile))
+    {
+      ns3TcpSocket->TraceConnectWithoutContext ("CongestionWindow", MakeBoundCallback (&CwndChangeAsync, &cwndWriter));
+    }
+  else
+    {
+      ns3TcpSocket->TraceConnectWithoutContext ("CongestionWindow", MakeCallback (&CwndChange));
+    }
 
   // Create TCP application at n0
   Ptr<MyApp> app = CreateObject<MyApp> ();
   app->Setup (ns3TcpSocket, sinkAddress, 1040, 100000, DataRate ("250Kbps"));
+  app->SetBurstSize (burstSize);
   c.Get (0)->AddApplication (app);
   app->SetStartTime (Seconds (1.));
   app->SetStopTime (Seconds (100.));
@@ -303,6 +228,7 @@ int main (int argc, char *argv[])
   // Create UDP application at n1
   Ptr<MyApp> app2 = CreateObject<MyApp> ();
   app2->Setup (ns3UdpSocket, sinkAddress2, 1040, 100000, DataRate ("250Kbps"));
+  app2->SetBurstSize (burstSize);
   c.Get (1)->AddApplication (app2);
   app2->SetStartTime (Seconds (20.));
   app2->SetStopTime (Seconds (100.));
@@ -323,12 +249,20 @@ int main (int argc, char *argv[])
 //
   NS_LOG_INFO ("Run Simulation.");
   Simulator::Stop (Seconds(100.0));
+  BenchReport::SetupDone ();
   Simulator::Run ();
+  BenchReport::Finish ();
   if (enableFlowMonitor)
     {
 	  flowmon->CheckForLostPackets ();
 	  flowmon->SerializeToXmlFile("lab-2.flowmon", true, true);
     }
+  if (cwndWriter.IsOpen ())
+    {
+      cwndWriter.Close ();
+      NS_LOG_INFO ("cwnd records: " << cwndWriter.GetRecordsQueued () << " written, " << cwndWriter.GetRecordsDropped ()
+                   << " dropped, queue high water " << cwndWriter.GetHighWaterMark () << " bytes");
+    }
   Simulator::Destroy ();
   NS_LOG_INFO ("Done.");
 }
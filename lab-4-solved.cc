@@ -76,6 +76,8 @@
 #include "ns3/mobility-module.h"
 #include "ns3/netanim-module.h"
 #include "myapp.h"
+#include "trace-replay.h"
+#include "async-writer.h"
 
 NS_LOG_COMPONENT_DEFINE ("Lab4");
 
@@ -98,16 +100,28 @@ ReceivePacket(Ptr<const Packet> p, const Address & addr)
 	std::cout << Simulator::Now ().GetSeconds () << "\t" << p->GetSize() <<"\n";
 }
 
+void
+ReceivePacketAsync (AsyncWriter *writer, Ptr<const Packet> p, const Address & addr)
+{
+	char line[64];
+	int length = snprintf (line, sizeof (line), "%g\t%u\n", Simulator::Now ().GetSeconds (), p->GetSize ());
+	writer->WriteWait (line, length);
+}
+
 
 int main (int argc, char *argv[])
 {
   ns3::PacketMetadata::Enable ();
   bool enableFlowMonitor = false;
   std::string phyMode ("DsssRate1Mbps");
+  std::string traceFile;
+  std::string rxFile;
 
   CommandLine cmd;
   cmd.AddValue ("EnableMonitor", "Enable Flow Monitor", enableFlowMonitor);
   cmd.AddValue ("phyMode", "Wifi Phy mode", phyMode);
+  cmd.AddValue ("traceFile", "Replay flow 0 of this binary packet trace instead of constant-rate traffic", traceFile);
+  cmd.AddValue ("rxFile", "Write the received packet trace to this file from a background thread instead of stdout", rxFile);
   cmd.Parse (argc, argv);
 
 //
@@ -189,8 +203,20 @@ int main (int argc, char *argv[])
   Ptr<Socket> ns3UdpSocket = Socket::CreateSocket (c.Get (0), UdpSocketFactory::GetTypeId ()); //source at n0
 
   // Create UDP application at n0
-  Ptr<MyApp> app = CreateObject<MyApp> ();
-  app->Setup (ns3UdpSocket, sinkAddress, 1040, 100000, DataRate ("250Kbps"));
+  Ptr<Application> app;
+  if (traceFile.empty ())
+    {
+      Ptr<MyApp> myApp = CreateObject<MyApp> ();
+      myApp->Setup (ns3UdpSocket, sinkAddress, 1040, 100000, DataRate ("250Kbps"));
+      app = myApp;
+    }
+  else
+    {
+      Ptr<TraceReplayApp> replayApp = CreateObject<TraceReplayApp> ();
+      replayApp->Setup (traceFile);
+      replayApp->AddFlow (0, ns3UdpSocket, sinkAddress);
+      app = replayApp;
+    }
   c.Get (0)->AddApplication (app);
   app->SetStartTime (Seconds (1.));
   app->SetStopTime (Seconds (100.));
@@ -213,7 +239,15 @@ int main (int argc, char *argv[])
   Simulator::Schedule (Seconds (35.0), &SetPosition, c.Get (1), 1000.0);
 
   // Trace Received Packets
-  Config::ConnectWithoutContext("/NodeList/*/ApplicationList/*/$ns3::PacketSink/Rx", MakeCallback (&ReceivePacket));
+  AsyncWriter rxWriter;
+  if (!rxFile.empty () && rxWriter.Open (rxFile))
+    {
+      Config::ConnectWithoutContext("/NodeList/*/ApplicationList/*/$ns3::PacketSink/Rx", MakeBoundCallback (&ReceivePacketAsync, &rxWriter));
+    }
+  else
+    {
+      Config::ConnectWithoutContext("/NodeList/*/ApplicationList/*/$ns3::PacketSink/Rx", MakeCallback (&ReceivePacket));
+    }
 
 // Trace devices (pcap)
   wifiPhy.EnablePcap ("lab-4-dev", devices);
@@ -241,6 +275,12 @@ int main (int argc, char *argv[])
 	  flowmon->CheckForLostPackets ();
 	  flowmon->SerializeToXmlFile("lab-4.flowmon", true, true);
     }
+  if (rxWriter.IsOpen ())
+    {
+      rxWriter.Close ();
+      NS_LOG_INFO ("rx records: " << rxWriter.GetRecordsQueued () << " written, " << rxWriter.GetRecordsDropped ()
+                   << " dropped, queue high water " << rxWriter.GetHighWaterMark () << " bytes");
+    }
   
     
   Simulator::Destroy ();
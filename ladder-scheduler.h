@@ -0,0 +1,361 @@
+#ifndef LADDER_SCHEDULER_H
+#define LADDER_SCHEDULER_H
+
+#include "ns3/core-module.h"
+
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+/*
+ * LadderScheduler keeps the simulator events in a ladder queue (Tang, Goh
+ * and Thng, "Ladder Queue: An O(1) Priority Queue Structure for Large-Scale
+ * Discrete Event Simulation", 2005): Insert () and RemoveNext () are O(1)
+ * amortized, where the MapScheduler pays O(log n) and an allocation for
+ * every event.
+ *
+ * Events past the current epoch are appended unsorted to Top. Once every
+ * nearer event has run, Top is spread over the buckets of a rung, the bucket
+ * width chosen from the span and number of its events. The first non-empty
+ * bucket of the finest rung is then sorted into Bottom, from which events
+ * are removed; a bucket of more than c_threshold events is spread over a
+ * finer rung instead. Only Bottom is ever sorted and it stays around
+ * c_threshold events long, so the beacons, peer-link timers, hellos and
+ * pacing events the mesh scenarios keep scheduling ahead of now are mostly
+ * a bucket append each.
+ *
+ * Events are ordered by timestamp and uid like in every ns-3 scheduler, so a
+ * run gives the same results as with the MapScheduler.
+ */
+class LadderScheduler : public Scheduler
+{
+public:
+  static TypeId GetTypeId (void);
+
+  LadderScheduler ();
+
+  virtual void Insert (const Event &ev);
+  virtual bool IsEmpty (void) const;
+  virtual Event PeekNext (void) const;
+  virtual Event RemoveNext (void);
+  virtual void Remove (const Event &ev);
+
+private:
+  /// Buckets sorted into Bottom at once, more are spread over a finer rung
+  static const uint32_t c_threshold = 50;
+  static const uint32_t c_maxRungs = 8;
+
+  struct Rung
+  {
+    Rung () : start (0), width (1), nBuckets (0), current (0), count (0) {}
+    uint64_t start;
+    uint64_t width;
+    uint32_t nBuckets;
+    /// Buckets before this one have been moved down already
+    uint32_t current;
+    uint32_t count;
+    /// The last bucket also takes everything after it
+    std::vector<std::vector<Event> > buckets;
+  };
+
+  /// Rung an event at ts belongs to, m_nRungs if it goes to Bottom
+  uint32_t FindRung (uint64_t ts) const;
+  uint32_t FindBucket (const Rung &rung, uint64_t ts) const;
+  /// Move events over the buckets of a new finest rung, false if they can't be
+  bool Spread (std::vector<Event> &events);
+  void MoveToBottom (std::vector<Event> &events);
+  /// Refill Bottom from the rungs or Top when it ran empty
+  void Fill (void);
+
+  std::vector<Event> m_top;
+  /// Events from this timestamp on go to Top
+  uint64_t           m_topStart;
+  uint64_t           m_topMax;
+  /// From the widest rung to the finest
+  Rung               m_rungs[c_maxRungs];
+  uint32_t           m_nRungs;
+  /// Sorted latest first, the next event is at the back
+  std::vector<Event> m_bottom;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (LadderScheduler);
+
+/*
+ * SchedulerOption picks the simulator event scheduler from the short name
+ * given on a scenario command line: map (the ns-3 default), heap, list,
+ * calendar or ladder. Other names are taken as ns-3 TypeId names.
+ *
+ *   cmd.AddValue ("scheduler", "Event scheduler: map, heap, list, calendar or ladder. [map]", m_scheduler);
+ *   ...
+ *   if (!SchedulerOption::Set (m_scheduler))
+ */
+class SchedulerOption
+{
+public:
+  static std::string GetTypeName (std::string name);
+  /// Run the simulator on the named scheduler, false if there is no such scheduler
+  static bool Set (std::string name);
+};
+
+static bool
+LadderLater (const Scheduler::Event &a, const Scheduler::Event &b)
+{
+  return b.key < a.key;
+}
+
+TypeId
+LadderScheduler::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LadderScheduler")
+    .SetParent (Scheduler::GetTypeId ())
+    .AddConstructor<LadderScheduler> ()
+  ;
+  return tid;
+}
+
+LadderScheduler::LadderScheduler ()
+  : m_topStart (0),
+    m_topMax (0),
+    m_nRungs (0)
+{
+}
+
+uint32_t
+LadderScheduler::FindRung (uint64_t ts) const
+{
+  for (uint32_t i = 0; i < m_nRungs; ++i)
+    {
+      const Rung &rung = m_rungs[i];
+      // A rung whose buckets have all been moved down takes nothing anymore
+      if (rung.current < rung.nBuckets && ts >= rung.start + rung.current * rung.width)
+        {
+          return i;
+        }
+    }
+  return m_nRungs;
+}
+
+uint32_t
+LadderScheduler::FindBucket (const Rung &rung, uint64_t ts) const
+{
+  uint64_t bucket = (ts - rung.start) / rung.width;
+  return bucket < rung.nBuckets ? bucket : rung.nBuckets - 1;
+}
+
+bool
+LadderScheduler::Spread (std::vector<Event> &events)
+{
+  if (m_nRungs == c_maxRungs)
+    {
+      return false;
+    }
+  uint64_t min = events[0].key.m_ts;
+  uint64_t max = min;
+  for (uint32_t i = 1; i < events.size (); ++i)
+    {
+      min = std::min (min, events[i].key.m_ts);
+      max = std::max (max, events[i].key.m_ts);
+    }
+  if (max == min)
+    {
+      return false;
+    }
+
+  Rung &rung = m_rungs[m_nRungs++];
+  rung.start = min;
+  rung.width = (max - min) / events.size () + 1;
+  rung.nBuckets = (max - min) / rung.width + 1;
+  rung.current = 0;
+  rung.count = events.size ();
+  if (rung.buckets.size () < rung.nBuckets)
+    {
+      rung.buckets.resize (rung.nBuckets);
+    }
+  for (uint32_t i = 0; i < events.size (); ++i)
+    {
+      rung.buckets[(events[i].key.m_ts - min) / rung.width].push_back (events[i]);
+    }
+  events.clear ();
+  return true;
+}
+
+void
+LadderScheduler::MoveToBottom (std::vector<Event> &events)
+{
+  m_bottom.insert (m_bottom.end (), events.begin (), events.end ());
+  std::sort (m_bottom.begin (), m_bottom.end (), LadderLater);
+  events.clear ();
+}
+
+void
+LadderScheduler::Fill (void)
+{
+  while (m_bottom.empty ())
+    {
+      if (m_nRungs == 0)
+        {
+          if (m_top.empty ())
+            {
+              return;
+            }
+          // Start the next epoch with what was in Top
+          m_topStart = m_topMax + 1;
+          if (m_top.size () <= c_threshold || !Spread (m_top))
+            {
+              MoveToBottom (m_top);
+            }
+          continue;
+        }
+
+      Rung &rung = m_rungs[m_nRungs - 1];
+      if (rung.count == 0)
+        {
+          m_nRungs--;
+          continue;
+        }
+      while (rung.buckets[rung.current].empty ())
+        {
+          rung.current++;
+        }
+      std::vector<Event> &bucket = rung.buckets[rung.current];
+      rung.count -= bucket.size ();
+      rung.current++;
+      if (bucket.size () <= c_threshold || !Spread (bucket))
+        {
+          MoveToBottom (bucket);
+        }
+    }
+}
+
+void
+LadderScheduler::Insert (const Event &ev)
+{
+  uint64_t ts = ev.key.m_ts;
+  if (ts >= m_topStart)
+    {
+      m_top.push_back (ev);
+      m_topMax = std::max (m_topMax, ts);
+    }
+  else
+    {
+      uint32_t r = FindRung (ts);
+      if (r < m_nRungs)
+        {
+          m_rungs[r].buckets[FindBucket (m_rungs[r], ts)].push_back (ev);
+          m_rungs[r].count++;
+        }
+      else
+        {
+          m_bottom.insert (std::lower_bound (m_bottom.begin (), m_bottom.end (), ev, LadderLater), ev);
+          // Events keep arriving before the finest rung, give them a rung of their own
+          if (m_bottom.size () > c_threshold && m_bottom.front ().key.m_ts > m_bottom.back ().key.m_ts)
+            {
+              Spread (m_bottom);
+            }
+        }
+    }
+  Fill ();
+}
+
+bool
+LadderScheduler::IsEmpty (void) const
+{
+  // Fill () leaves Bottom empty only when everything is
+  return m_bottom.empty ();
+}
+
+Scheduler::Event
+LadderScheduler::PeekNext (void) const
+{
+  NS_ASSERT (!m_bottom.empty ());
+  return m_bottom.back ();
+}
+
+Scheduler::Event
+LadderScheduler::RemoveNext (void)
+{
+  NS_ASSERT (!m_bottom.empty ());
+  Event ev = m_bottom.back ();
+  m_bottom.pop_back ();
+  Fill ();
+  return ev;
+}
+
+void
+LadderScheduler::Remove (const Event &ev)
+{
+  uint64_t ts = ev.key.m_ts;
+  std::vector<Event> *events = &m_top;
+  if (ts < m_topStart)
+    {
+      uint32_t r = FindRung (ts);
+      if (r == m_nRungs)
+        {
+          std::vector<Event>::iterator it = std::lower_bound (m_bottom.begin (), m_bottom.end (), ev, LadderLater);
+          NS_ASSERT_MSG (it != m_bottom.end () && it->key.m_uid == ev.key.m_uid, "Event to remove not found");
+          m_bottom.erase (it);
+          Fill ();
+          return;
+        }
+      events = &m_rungs[r].buckets[FindBucket (m_rungs[r], ts)];
+      m_rungs[r].count--;
+    }
+  // Top and the buckets are unsorted
+  for (uint32_t i = 0; i < events->size (); ++i)
+    {
+      if ((*events)[i].key.m_uid == ev.key.m_uid)
+        {
+          (*events)[i] = events->back ();
+          events->pop_back ();
+          Fill ();
+          return;
+        }
+    }
+  NS_ASSERT_MSG (false, "Event to remove not found");
+}
+
+std::string
+SchedulerOption::GetTypeName (std::string name)
+{
+  if (name == "map")
+    {
+      return "ns3::MapScheduler";
+    }
+  if (name == "heap")
+    {
+      return "ns3::HeapScheduler";
+    }
+  if (name == "list")
+    {
+      return "ns3::ListScheduler";
+    }
+  if (name == "calendar")
+    {
+      return "ns3::CalendarScheduler";
+    }
+  if (name == "ladder")
+    {
+      return "ns3::LadderScheduler";
+    }
+  return name;
+}
+
+bool
+SchedulerOption::Set (std::string name)
+{
+  TypeId tid;
+  if (!TypeId::LookupByNameFailSafe (GetTypeName (name), &tid))
+    {
+      std::cerr << "Error: Unknown scheduler " << name << "\n";
+      return false;
+    }
+  ObjectFactory factory;
+  factory.SetTypeId (tid);
+  Simulator::SetScheduler (factory);
+  return true;
+}
+
+#endif /* LADDER_SCHEDULER_H */
@@ -0,0 +1,500 @@
+#ifndef LATENCY_PROBE_H
+#define LATENCY_PROBE_H
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "ns3/internet-module.h"
+#include "ns3/network-module.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <vector>
+
+using namespace ns3;
+
+/*
+ * In-band one-way latency measurement.
+ *
+ * A sender (TrafficApp with SetStamping) prefixes every packet with a
+ * LatencyHeader. LatencySink reads those headers back, for TCP out of the
+ * reassembled byte stream, and keeps per-flow latency histograms plus loss
+ * and reordering counters. Nothing here needs PacketMetadata or FlowMonitor.
+ */
+
+/// 16 bytes on the wire: flow id, sequence number, send time in ns
+class LatencyHeader : public Header
+{
+public:
+  static const uint32_t SIZE = 16;
+
+  LatencyHeader ();
+  static TypeId GetTypeId (void);
+  virtual TypeId GetInstanceTypeId (void) const;
+  virtual uint32_t GetSerializedSize (void) const;
+  virtual void Serialize (Buffer::Iterator start) const;
+  virtual uint32_t Deserialize (Buffer::Iterator start);
+  virtual void Print (std::ostream &os) const;
+
+  void Set (uint32_t flowId, uint32_t seq, Time txTime);
+  uint32_t GetFlowId (void) const;
+  uint32_t GetSeq (void) const;
+  Time GetTxTime (void) const;
+
+private:
+  uint32_t m_flowId;
+  uint32_t m_seq;
+  uint64_t m_txTime;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (LatencyHeader);
+
+LatencyHeader::LatencyHeader ()
+  : m_flowId (0),
+    m_seq (0),
+    m_txTime (0)
+{
+}
+
+TypeId
+LatencyHeader::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::LatencyHeader")
+    .SetParent (Header::GetTypeId ())
+    .AddConstructor<LatencyHeader> ()
+  ;
+  return tid;
+}
+
+TypeId
+LatencyHeader::GetInstanceTypeId (void) const
+{
+  return GetTypeId ();
+}
+
+uint32_t
+LatencyHeader::GetSerializedSize (void) const
+{
+  return SIZE;
+}
+
+void
+LatencyHeader::Serialize (Buffer::Iterator start) const
+{
+  start.WriteHtonU32 (m_flowId);
+  start.WriteHtonU32 (m_seq);
+  start.WriteHtonU64 (m_txTime);
+}
+
+uint32_t
+LatencyHeader::Deserialize (Buffer::Iterator start)
+{
+  m_flowId = start.ReadNtohU32 ();
+  m_seq = start.ReadNtohU32 ();
+  m_txTime = start.ReadNtohU64 ();
+  return SIZE;
+}
+
+void
+LatencyHeader::Print (std::ostream &os) const
+{
+  os << "flow=" << m_flowId << " seq=" << m_seq << " tx=" << m_txTime << "ns";
+}
+
+void
+LatencyHeader::Set (uint32_t flowId, uint32_t seq, Time txTime)
+{
+  m_flowId = flowId;
+  m_seq = seq;
+  m_txTime = txTime.GetNanoSeconds ();
+}
+
+uint32_t
+LatencyHeader::GetFlowId (void) const
+{
+  return m_flowId;
+}
+
+uint32_t
+LatencyHeader::GetSeq (void) const
+{
+  return m_seq;
+}
+
+Time
+LatencyHeader::GetTxTime (void) const
+{
+  return NanoSeconds (m_txTime);
+}
+
+/*
+ * Log-linear histogram in the style of HdrHistogram. Values below 128 ns get
+ * their own bucket; above that every power of two is split into 64 linear
+ * sub-buckets, so any recorded value is off by less than 1.6%. Add is a few
+ * bit operations and one increment.
+ */
+class LatencyHistogram
+{
+public:
+  LatencyHistogram ();
+
+  void Add (uint64_t ns);
+  void Reset (void);
+  uint64_t GetCount (void) const;
+  /// Smallest recorded value (bucket lower bound) at or above quantile q in [0, 1]
+  uint64_t GetPercentile (double q) const;
+
+private:
+  static const uint32_t LINEAR = 128;
+  static const uint32_t SUB_BUCKETS = 64;
+  static const uint32_t BUCKETS = LINEAR + 57 * SUB_BUCKETS;
+
+  static uint32_t IndexOf (uint64_t ns);
+  static uint64_t ValueOf (uint32_t index);
+
+  std::vector<uint64_t> m_counts;
+  uint64_t m_total;
+};
+
+LatencyHistogram::LatencyHistogram ()
+  : m_counts (BUCKETS, 0),
+    m_total (0)
+{
+}
+
+uint32_t
+LatencyHistogram::IndexOf (uint64_t ns)
+{
+  if (ns < LINEAR)
+    {
+      return ns;
+    }
+  uint32_t msb = 63 - __builtin_clzll (ns);
+  uint32_t shift = msb - 6;
+  return LINEAR + (shift - 1) * SUB_BUCKETS + ((ns >> shift) - SUB_BUCKETS);
+}
+
+uint64_t
+LatencyHistogram::ValueOf (uint32_t index)
+{
+  if (index < LINEAR)
+    {
+      return index;
+    }
+  uint32_t shift = (index - LINEAR) / SUB_BUCKETS + 1;
+  uint64_t sub = (index - LINEAR) % SUB_BUCKETS + SUB_BUCKETS;
+  return sub << shift;
+}
+
+void
+LatencyHistogram::Add (uint64_t ns)
+{
+  m_counts[IndexOf (ns)]++;
+  m_total++;
+}
+
+void
+LatencyHistogram::Reset (void)
+{
+  std::fill (m_counts.begin (), m_counts.end (), 0);
+  m_total = 0;
+}
+
+uint64_t
+LatencyHistogram::GetCount (void) const
+{
+  return m_total;
+}
+
+uint64_t
+LatencyHistogram::GetPercentile (double q) const
+{
+  if (m_total == 0)
+    {
+      return 0;
+    }
+  uint64_t rank = static_cast<uint64_t> (q * m_total);
+  if (rank >= m_total)
+    {
+      rank = m_total - 1;
+    }
+  uint64_t seen = 0;
+  for (uint32_t i = 0; i < BUCKETS; ++i)
+    {
+      seen += m_counts[i];
+      if (seen > rank)
+        {
+          return ValueOf (i);
+        }
+    }
+  return ValueOf (BUCKETS - 1);
+}
+
+/// Receives stamped traffic and keeps per-flow latency, loss and reordering
+class LatencySink : public Application
+{
+public:
+
+  LatencySink ();
+  virtual ~LatencySink();
+
+  /// socketFactory is TcpSocketFactory or UdpSocketFactory; every sender uses packetSize
+  void Setup (TypeId socketFactory, uint16_t port, uint32_t packetSize);
+  /// Print p50/p99/p999 latency, loss and reordering of every flow in the current window
+  void Report (std::ostream &os) const;
+  /// Start a new measurement window, e.g. at a handover: histograms and counters restart
+  void ResetWindow (void);
+
+private:
+  struct FlowLatency
+  {
+    FlowLatency ();
+    LatencyHistogram histogram;
+    uint64_t received;
+    uint64_t reordered;
+    uint32_t nextSeq;
+    /// nextSeq when the window started
+    uint32_t windowSeq;
+    bool     active;
+  };
+
+  /// Position inside the fixed-size messages of one TCP connection
+  struct StreamState
+  {
+    StreamState ();
+    uint32_t offset;
+    uint8_t  header[LatencyHeader::SIZE];
+  };
+
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+
+  void HandleAccept (Ptr<Socket> socket, const Address &from);
+  void HandleRead (Ptr<Socket> socket);
+  void Consume (StreamState &state, const uint8_t *data, uint32_t size);
+  void Record (const uint8_t *header);
+
+  static uint32_t ReadU32 (const uint8_t *p);
+
+  TypeId          m_tid;
+  uint16_t        m_port;
+  uint32_t        m_packetSize;
+  Ptr<Socket>     m_socket;
+  std::vector<Ptr<Socket> > m_accepted;
+  std::map<Ptr<Socket>, StreamState> m_streams;
+  std::vector<uint8_t> m_scratch;
+  std::vector<FlowLatency> m_flows;
+};
+
+LatencySink::FlowLatency::FlowLatency ()
+  : received (0),
+    reordered (0),
+    nextSeq (0),
+    windowSeq (0),
+    active (false)
+{
+}
+
+LatencySink::StreamState::StreamState ()
+  : offset (0)
+{
+}
+
+LatencySink::LatencySink ()
+  : m_tid (UdpSocketFactory::GetTypeId ()),
+    m_port (0),
+    m_packetSize (0),
+    m_socket (0)
+{
+}
+
+LatencySink::~LatencySink()
+{
+  m_socket = 0;
+}
+
+void
+LatencySink::Setup (TypeId socketFactory, uint16_t port, uint32_t packetSize)
+{
+  m_tid = socketFactory;
+  m_port = port;
+  m_packetSize = packetSize;
+}
+
+void
+LatencySink::ResetWindow (void)
+{
+  for (uint32_t i = 0; i < m_flows.size (); ++i)
+    {
+      FlowLatency &flow = m_flows[i];
+      flow.histogram.Reset ();
+      flow.received = 0;
+      flow.reordered = 0;
+      flow.windowSeq = flow.nextSeq;
+    }
+}
+
+void
+LatencySink::Report (std::ostream &os) const
+{
+  for (uint32_t i = 0; i < m_flows.size (); ++i)
+    {
+      const FlowLatency &flow = m_flows[i];
+      if (!flow.active)
+        {
+          continue;
+        }
+      // Late packets of the previous window can make received exceed the span
+      uint64_t span = flow.nextSeq - flow.windowSeq;
+      uint64_t lost = span > flow.received ? span - flow.received : 0;
+      os << "Flow " << i << " at " << Simulator::Now ().GetSeconds () << "s:"
+         << " p50=" << flow.histogram.GetPercentile (0.5) / 1e6 << "ms"
+         << " p99=" << flow.histogram.GetPercentile (0.99) / 1e6 << "ms"
+         << " p999=" << flow.histogram.GetPercentile (0.999) / 1e6 << "ms"
+         << " received=" << flow.received
+         << " lost=" << lost
+         << " reordered=" << flow.reordered << "\n";
+    }
+}
+
+void
+LatencySink::StartApplication (void)
+{
+  m_scratch.resize (65536);
+  if (!m_socket)
+    {
+      m_socket = Socket::CreateSocket (GetNode (), m_tid);
+      m_socket->Bind (InetSocketAddress (Ipv4Address::GetAny (), m_port));
+      m_socket->Listen ();
+    }
+  m_socket->SetRecvCallback (MakeCallback (&LatencySink::HandleRead, this));
+  m_socket->SetAcceptCallback (MakeNullCallback<bool, Ptr<Socket>, const Address &> (),
+                               MakeCallback (&LatencySink::HandleAccept, this));
+}
+
+void
+LatencySink::StopApplication (void)
+{
+  for (uint32_t i = 0; i < m_accepted.size (); ++i)
+    {
+      m_accepted[i]->Close ();
+    }
+  m_accepted.clear ();
+  m_streams.clear ();
+  if (m_socket)
+    {
+      m_socket->Close ();
+      m_socket->SetRecvCallback (MakeNullCallback<void, Ptr<Socket> > ());
+    }
+}
+
+void
+LatencySink::HandleAccept (Ptr<Socket> socket, const Address &from)
+{
+  socket->SetRecvCallback (MakeCallback (&LatencySink::HandleRead, this));
+  m_accepted.push_back (socket);
+  m_streams[socket] = StreamState ();
+}
+
+void
+LatencySink::HandleRead (Ptr<Socket> socket)
+{
+  bool datagram = m_tid == UdpSocketFactory::GetTypeId ();
+  Ptr<Packet> packet;
+  Address from;
+  while ((packet = socket->RecvFrom (from)))
+    {
+      uint32_t size = packet->GetSize ();
+      if (size == 0)
+        {
+          break;
+        }
+      if (size > m_scratch.size ())
+        {
+          m_scratch.resize (size);
+        }
+      packet->CopyData (&m_scratch[0], size);
+
+      if (datagram)
+        {
+          // Every datagram is one whole message
+          StreamState state;
+          Consume (state, &m_scratch[0], size);
+        }
+      else
+        {
+          Consume (m_streams[socket], &m_scratch[0], size);
+        }
+    }
+}
+
+void
+LatencySink::Consume (StreamState &state, const uint8_t *data, uint32_t size)
+{
+  uint32_t message = m_packetSize > LatencyHeader::SIZE ? m_packetSize : LatencyHeader::SIZE;
+  while (size > 0)
+    {
+      if (state.offset < LatencyHeader::SIZE)
+        {
+          uint32_t take = LatencyHeader::SIZE - state.offset;
+          take = take < size ? take : size;
+          std::copy (data, data + take, state.header + state.offset);
+          state.offset += take;
+          data += take;
+          size -= take;
+          if (state.offset == LatencyHeader::SIZE)
+            {
+              Record (state.header);
+            }
+          continue;
+        }
+      // Skip the payload up to the start of the next message
+      uint32_t skip = message - state.offset;
+      skip = skip < size ? skip : size;
+      state.offset += skip;
+      data += skip;
+      size -= skip;
+      if (state.offset >= message)
+        {
+          state.offset = 0;
+        }
+    }
+}
+
+uint32_t
+LatencySink::ReadU32 (const uint8_t *p)
+{
+  return (static_cast<uint32_t> (p[0]) << 24)
+         | (static_cast<uint32_t> (p[1]) << 16)
+         | (static_cast<uint32_t> (p[2]) << 8)
+         | static_cast<uint32_t> (p[3]);
+}
+
+void
+LatencySink::Record (const uint8_t *header)
+{
+  uint32_t flowId = ReadU32 (header);
+  uint32_t seq = ReadU32 (header + 4);
+  uint64_t txTime = (static_cast<uint64_t> (ReadU32 (header + 8)) << 32) | ReadU32 (header + 12);
+
+  if (flowId >= m_flows.size ())
+    {
+      m_flows.resize (flowId + 1);
+    }
+  FlowLatency &flow = m_flows[flowId];
+  flow.active = true;
+  flow.received++;
+  if (seq < flow.nextSeq)
+    {
+      flow.reordered++;
+    }
+  else
+    {
+      flow.nextSeq = seq + 1;
+    }
+
+  uint64_t now = Simulator::Now ().GetNanoSeconds ();
+  flow.histogram.Add (now > txTime ? now - txTime : 0);
+}
+
+#endif /* LATENCY_PROBE_H */
@@ -0,0 +1,236 @@
+#ifndef LOSS_CACHE_H
+#define LOSS_CACHE_H
+
+#include "ns3/core-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/wifi-module.h"
+#include "ns3/propagation-module.h"
+
+#include <iostream>
+#include <map>
+#include <vector>
+
+using namespace ns3;
+
+/*
+ * CachedPropagationLossModel wraps the loss chain of a channel and keeps
+ * the received power of every pair of fixed nodes, so a frame from a mesh
+ * point or AP costs one table read per receiver instead of a Friis, two-ray
+ * or log-distance computation.
+ *
+ * Nodes with a ConstantPositionMobilityModel are fixed; their CourseChange
+ * trace (SetPosition ()) bumps a version that makes their entries stale. A
+ * pair with any other mobility model, like the RandomWalk2d STAs, is computed
+ * directly every time. Entries also remember the transmit power, so power
+ * control only costs a miss.
+ *
+ * Rows are kept per transmitter and columns per receiver, indexed in the
+ * order the models are first seen. The channel asks for every receiver in
+ * the same order on every frame, so the next column is guessed before the
+ * index is looked up.
+ *
+ * Only deterministic chains can be cached: a fading model would be frozen.
+ */
+class CachedPropagationLossModel : public PropagationLossModel
+{
+public:
+  static TypeId GetTypeId (void);
+
+  CachedPropagationLossModel ();
+
+  void SetInner (Ptr<PropagationLossModel> inner);
+
+  uint64_t GetHits (void) const;
+  /// Fixed pairs computed because they were new or stale
+  uint64_t GetMisses (void) const;
+  /// Pairs with a moving node, never cached
+  uint64_t GetDirect (void) const;
+  void PrintStats (std::ostream &os) const;
+
+private:
+  struct Model
+  {
+    const MobilityModel *model;
+    bool                 fixed;
+    uint32_t             version;
+  };
+  struct Entry
+  {
+    Entry () : version (0), txPowerDbm (0), rxPowerDbm (0) {}
+    /// Sum of the versions of both models plus one, 0 when empty
+    uint32_t version;
+    double   txPowerDbm;
+    double   rxPowerDbm;
+  };
+
+  virtual double DoCalcRxPower (double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const;
+  virtual int64_t DoAssignStreams (int64_t stream);
+
+  /// Index of a model, registering it on first sight
+  uint32_t GetIndex (Ptr<MobilityModel> model, uint32_t guess) const;
+  void CourseChanged (Ptr<const MobilityModel> model);
+
+  Ptr<PropagationLossModel>                     m_inner;
+  mutable std::map<const MobilityModel *, uint32_t> m_index;
+  mutable std::vector<Model>                    m_models;
+  mutable std::vector<std::vector<Entry> >      m_rows;
+  mutable uint32_t                              m_lastTx;
+  mutable uint32_t                              m_lastRx;
+  mutable uint64_t                              m_hits;
+  mutable uint64_t                              m_misses;
+  mutable uint64_t                              m_direct;
+};
+
+NS_OBJECT_ENSURE_REGISTERED (CachedPropagationLossModel);
+
+/*
+ * LossCache wraps the loss model of a YansWifiChannel in a
+ * CachedPropagationLossModel. Install () after the mobility models.
+ */
+class LossCache
+{
+public:
+  static Ptr<CachedPropagationLossModel> Install (Ptr<YansWifiChannel> channel);
+};
+
+TypeId
+CachedPropagationLossModel::GetTypeId (void)
+{
+  static TypeId tid = TypeId ("ns3::CachedPropagationLossModel")
+    .SetParent (PropagationLossModel::GetTypeId ())
+    .AddConstructor<CachedPropagationLossModel> ()
+  ;
+  return tid;
+}
+
+CachedPropagationLossModel::CachedPropagationLossModel ()
+  : m_lastTx (0),
+    m_lastRx (0),
+    m_hits (0),
+    m_misses (0),
+    m_direct (0)
+{
+}
+
+void
+CachedPropagationLossModel::SetInner (Ptr<PropagationLossModel> inner)
+{
+  m_inner = inner;
+}
+
+uint64_t
+CachedPropagationLossModel::GetHits (void) const
+{
+  return m_hits;
+}
+
+uint64_t
+CachedPropagationLossModel::GetMisses (void) const
+{
+  return m_misses;
+}
+
+uint64_t
+CachedPropagationLossModel::GetDirect (void) const
+{
+  return m_direct;
+}
+
+void
+CachedPropagationLossModel::PrintStats (std::ostream &os) const
+{
+  uint64_t total = m_hits + m_misses + m_direct;
+  os << "Loss cache: " << m_hits << " hits, " << m_misses << " misses, " << m_direct << " direct (moving), "
+     << (total > 0 ? 100.0 * m_hits / total : 0) << "% hit rate over " << m_models.size () << " nodes\n";
+}
+
+uint32_t
+CachedPropagationLossModel::GetIndex (Ptr<MobilityModel> model, uint32_t guess) const
+{
+  const MobilityModel *key = PeekPointer (model);
+  if (guess < m_models.size () && m_models[guess].model == key)
+    {
+      return guess;
+    }
+  std::map<const MobilityModel *, uint32_t>::const_iterator found = m_index.find (key);
+  if (found != m_index.end ())
+    {
+      return found->second;
+    }
+
+  Model entry;
+  entry.model = key;
+  entry.fixed = DynamicCast<ConstantPositionMobilityModel> (model) != 0;
+  entry.version = 0;
+  uint32_t index = m_models.size ();
+  m_models.push_back (entry);
+  m_index[key] = index;
+  model->TraceConnectWithoutContext ("CourseChange", MakeCallback (&CachedPropagationLossModel::CourseChanged,
+                                                                   const_cast<CachedPropagationLossModel *> (this)));
+  return index;
+}
+
+void
+CachedPropagationLossModel::CourseChanged (Ptr<const MobilityModel> model)
+{
+  std::map<const MobilityModel *, uint32_t>::const_iterator found = m_index.find (PeekPointer (model));
+  if (found != m_index.end ())
+    {
+      m_models[found->second].version++;
+    }
+}
+
+double
+CachedPropagationLossModel::DoCalcRxPower (double txPowerDbm, Ptr<MobilityModel> a, Ptr<MobilityModel> b) const
+{
+  uint32_t tx = GetIndex (a, m_lastTx);
+  uint32_t rx = GetIndex (b, m_lastTx == tx ? m_lastRx + 1 : 0);
+  m_lastTx = tx;
+  m_lastRx = rx;
+  if (!m_models[tx].fixed || !m_models[rx].fixed)
+    {
+      m_direct++;
+      return m_inner->CalcRxPower (txPowerDbm, a, b);
+    }
+
+  if (m_rows.size () <= tx)
+    {
+      m_rows.resize (tx + 1);
+    }
+  std::vector<Entry> &row = m_rows[tx];
+  if (row.size () <= rx)
+    {
+      row.resize (m_models.size ());
+    }
+  Entry &entry = row[rx];
+  uint32_t version = m_models[tx].version + m_models[rx].version + 1;
+  if (entry.version == version && entry.txPowerDbm == txPowerDbm)
+    {
+      m_hits++;
+      return entry.rxPowerDbm;
+    }
+  m_misses++;
+  entry.version = version;
+  entry.txPowerDbm = txPowerDbm;
+  entry.rxPowerDbm = m_inner->CalcRxPower (txPowerDbm, a, b);
+  return entry.rxPowerDbm;
+}
+
+int64_t
+CachedPropagationLossModel::DoAssignStreams (int64_t stream)
+{
+  return m_inner->AssignStreams (stream);
+}
+
+Ptr<CachedPropagationLossModel>
+LossCache::Install (Ptr<YansWifiChannel> channel)
+{
+  PointerValue value;
+  channel->GetAttribute ("PropagationLossModel", value);
+  Ptr<CachedPropagationLossModel> cache = CreateObject<CachedPropagationLossModel> ();
+  cache->SetInner (value.Get<PropagationLossModel> ());
+  channel->SetPropagationLossModel (cache);
+  return cache;
+}
+
+#endif /* LOSS_CACHE_H */
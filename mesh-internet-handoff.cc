@@ -21,6 +21,8 @@
 #include "ns3/ipv4-global-routing-helper.h"
 #include "ns3/netanim-module.h"
 #include "src/network/model/packet-metadata.h"
+#include "rng-streams.h"
+#include "column-file.h"
 #include <iostream>
 #include <sstream>
 #include <fstream>
@@ -59,6 +61,11 @@ private:
   bool m_pcap;
   std::string m_stack;
   std::string m_root;
+  uint32_t m_run;
+  /// Fixed RNG streams, handed out in the order the scenario is built
+  RngStreams m_streams;
+  /// Columnar per-flow results of this run, none if empty
+  std::string m_resultFile;
   Ptr<FlowMonitor> flowMon;
 
   /// NodeContainer for individual nodes
@@ -117,6 +124,8 @@ private:
   void Report ();
   /// Setup FlowMonitor
   void InstallFlowMonitor ();
+  /// Write the per-flow results to m_resultFile
+  void WriteResults ();
 };
 
 MeshTest::MeshTest () :
@@ -140,7 +149,9 @@ m_nIfaces (1),
 m_chan (true),
 m_pcap (false),
 m_stack ("ns3::Dot11sStack"),
-m_root ("ff:ff:ff:ff:ff:ff") { }
+m_root ("ff:ff:ff:ff:ff:ff"),
+m_run (0),
+m_resultFile ("") { }
 
 void
 MeshTest::Configure (int argc, char *argv[])
@@ -168,7 +179,10 @@ MeshTest::Configure (int argc, char *argv[])
   cmd.AddValue ("stack", "Type of protocol stack. ns3::Dot11sStack by default", m_stack);
   cmd.AddValue ("root", "Mac address of root mesh point in HWMP", m_root);
 
+  cmd.AddValue ("result-file", "Also write per-flow results of this run to a columnar file (.cols)", m_resultFile);
+  cmd.AddValue ("run", "Replication number, each one draws from independent random substreams. [0: keep --RngRun]", m_run);
   cmd.Parse (argc, argv);
+  RngStreams::SetRun (m_run);
   NS_LOG_DEBUG ("Grid:" << m_xSize << "*" << m_ySize);
   NS_LOG_DEBUG ("Simulation time: " << m_totalTime << " s");
 }
@@ -309,6 +323,11 @@ MeshTest::CreateNodes ()
     {
       de_ap2.Add (wifi1.Install (wifiPhy, mac1, nc_mbb2.Get (i)));
     }
+  m_streams.Assign (meshHelper1, de_mesh1);
+  m_streams.Assign (meshHelper2, de_mesh2);
+  m_streams.Assign (wifi1, NetDeviceContainer (de_sta1, de_ap1));
+  m_streams.Assign (wifi2, de_sta2);
+  m_streams.Assign (wifi1, de_ap2);
 
   // Net Device container for STA and AP in network 1
   de_wifi_sta1Ap1.Add (de_sta1);
@@ -452,6 +471,8 @@ MeshTest::InstallInternetStack ()
   internetStackHelper.Install (nc_gw1);
   internetStackHelper.Install (nc_gw2);
   internetStackHelper.Install (nc_bb1);
+  m_streams.Assign (internetStackHelper, NodeContainer::GetGlobal ());
+  m_streams.Assign (routingProtocol, NodeContainer::GetGlobal ());
 
 
   // Network 1
@@ -507,8 +528,13 @@ MeshTest::Run ()
   AnimationInterface animation ("mesh-internet-handoff.xml");
   animation.EnablePacketMetadata (false);
 
+  m_streams.AssignNodes (NodeContainer::GetGlobal ());
   Simulator::Run ();
   flowMon->SerializeToXmlFile ("mesh-internet-handoff-flowmon.xml", true, true);
+  if (!m_resultFile.empty ())
+    {
+      WriteResults ();
+    }
   Simulator::Destroy ();
 
   return 0;
@@ -523,6 +549,54 @@ MeshTest::InstallFlowMonitor ()
   flowMon = fmHelper.Install (nc_sta1.Get (0));
 }
 
+void
+MeshTest::WriteResults ()
+{
+  flowMon->CheckForLostPackets ();
+  Ptr<Ipv4FlowClassifier> classifier = DynamicCast<Ipv4FlowClassifier> (fmHelper.GetClassifier ());
+  std::map<FlowId, FlowMonitor::FlowStats> stats = flowMon->GetFlowStats ();
+
+  ColumnFileWriter results;
+  uint32_t srcAddr = results.AddColumn ("srcAddr", ColumnFileWriter::UINT32);
+  uint32_t dstAddr = results.AddColumn ("dstAddr", ColumnFileWriter::UINT32);
+  uint32_t firstTx = results.AddColumn ("timeFirstTxPacket", ColumnFileWriter::DOUBLE);
+  uint32_t lastRx = results.AddColumn ("timeLastRxPacket", ColumnFileWriter::DOUBLE);
+  uint32_t delaySum = results.AddColumn ("delaySum", ColumnFileWriter::DOUBLE);
+  uint32_t txBytes = results.AddColumn ("txBytes", ColumnFileWriter::UINT64);
+  uint32_t rxBytes = results.AddColumn ("rxBytes", ColumnFileWriter::UINT64);
+  uint32_t txPackets = results.AddColumn ("txPackets", ColumnFileWriter::UINT32);
+  uint32_t rxPackets = results.AddColumn ("rxPackets", ColumnFileWriter::UINT32);
+  uint32_t lostPackets = results.AddColumn ("lostPackets", ColumnFileWriter::UINT32);
+  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator i = stats.begin (); i != stats.end (); ++i)
+    {
+      Ipv4FlowClassifier::FiveTuple t = classifier->FindFlow (i->first);
+      results.AppendUint (srcAddr, t.sourceAddress.Get ());
+      results.AppendUint (dstAddr, t.destinationAddress.Get ());
+      results.AppendDouble (firstTx, i->second.timeFirstTxPacket.GetSeconds ());
+      results.AppendDouble (lastRx, i->second.timeLastRxPacket.GetSeconds ());
+      results.AppendDouble (delaySum, i->second.delaySum.GetSeconds ());
+      results.AppendUint (txBytes, i->second.txBytes);
+      results.AppendUint (rxBytes, i->second.rxBytes);
+      results.AppendUint (txPackets, i->second.txPackets);
+      results.AppendUint (rxPackets, i->second.rxPackets);
+      results.AppendUint (lostPackets, i->second.lostPackets);
+    }
+
+  std::ostringstream param;
+  param << m_xSize << "x" << m_ySize;
+  results.SetParameter ("grid", param.str ());
+  param.str ("");
+  param << m_totalTime;
+  results.SetParameter ("time", param.str ());
+  param.str ("");
+  param << RngSeedManager::GetSeed ();
+  results.SetParameter ("seed", param.str ());
+  param.str ("");
+  param << RngSeedManager::GetRun ();
+  results.SetParameter ("run", param.str ());
+  results.Write (m_resultFile);
+}
+
 int
 main (int argc, char *argv[])
 {
@@ -0,0 +1,449 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Replication controller for one scenario configuration.
+ *
+ * Replications of --program are started as separate processes, at most
+ * --jobs at a time, each with its own --run number (see rng-streams.h) and
+ * in its own directory <out>/rep-<n>, so files the scenario always writes
+ * under the same name do not collide. Each replication writes its flows to
+ * <out>/rep-<n>/result.cols (see column-file.h).
+ *
+ * As soon as a replication finishes its per-run metrics are folded into the
+ * running estimates:
+ *
+ *   throughput  mean flow throughput (Kbps)
+ *   delay       mean packet delay (s)
+ *   loss        lost / transmitted packets
+ *
+ * No new replication is started once at least --min-runs are done and the
+ * 95% confidence half-width of every metric in --metrics is under --target
+ * times its mean, or when --max-runs have been started. Replications still
+ * running at that point are waited for and counted.
+ *
+ * <out>/replications.tsv gets one line per finished replication with its
+ * exit status. Finished replications are kept, so starting the controller
+ * again with a smaller --target only runs the extra replications needed: on
+ * start every rep-<n> directory is looked at, and a replication counts as a
+ * sample only if its last line in replications.tsv says "ok". Ones recorded
+ * as failed stay failed, and ones with no status (the controller was killed
+ * before they finished) are run again, as are any missing numbers.
+ *
+ *   ./waf --run "mesh-replicate --program=build/scratch/mesh-internet-handoff
+ *                --metrics=throughput,delay --target=0.05"
+ */
+
+#include "ns3/core-module.h"
+#include "column-file.h"
+#include "process-runner.h"
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <dirent.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("MeshReplicate");
+
+/// Running mean and variance of one metric over the replications (Welford)
+struct Estimate
+{
+  Estimate () : n (0), mean (0), m2 (0) {}
+  uint32_t n;
+  double mean;
+  double m2;
+};
+
+static void
+AddSample (Estimate &e, double x)
+{
+  e.n++;
+  double delta = x - e.mean;
+  e.mean += delta / e.n;
+  e.m2 += delta * (x - e.mean);
+}
+
+/// Two-sided 95% Student t quantile for n - 1 degrees of freedom
+static double
+StudentT95 (uint32_t n)
+{
+  static const double t[] = { 12.706, 4.303, 3.182, 2.776, 2.571, 2.447, 2.365, 2.306, 2.262, 2.228,
+                              2.201, 2.179, 2.160, 2.145, 2.131, 2.120, 2.110, 2.101, 2.093, 2.086,
+                              2.080, 2.074, 2.069, 2.064, 2.060, 2.056, 2.052, 2.048, 2.045, 2.042 };
+  if (n < 2)
+    {
+      return 0;
+    }
+  if (n - 1 <= sizeof (t) / sizeof (t[0]))
+    {
+      return t[n - 2];
+    }
+  return 1.960;
+}
+
+/// 95% confidence half-width of the mean, infinite until there are two samples
+static double
+HalfWidth (const Estimate &e)
+{
+  if (e.n < 2)
+    {
+      return HUGE_VAL;
+    }
+  return StudentT95 (e.n) * std::sqrt (e.m2 / (e.n - 1) / e.n);
+}
+
+static std::string
+RunDir (std::string out, uint32_t run)
+{
+  std::ostringstream name;
+  name << out << "/rep-" << run;
+  return name.str ();
+}
+
+/// Numbers of the rep-<n> directories in out
+static std::vector<uint32_t>
+FindRunDirs (std::string out)
+{
+  std::vector<uint32_t> runs;
+  DIR *dir = opendir (out.c_str ());
+  if (dir == 0)
+    {
+      return runs;
+    }
+  struct dirent *entry;
+  while ((entry = readdir (dir)) != 0)
+    {
+      std::string name = entry->d_name;
+      char *end;
+      unsigned long run = name.compare (0, 4, "rep-") == 0 ? std::strtoul (name.c_str () + 4, &end, 10) : 0;
+      if (run > 0 && *end == '\0')
+        {
+          runs.push_back (run);
+        }
+    }
+  closedir (dir);
+  std::sort (runs.begin (), runs.end ());
+  return runs;
+}
+
+/// Last status of every replication in the manifest, "ok" or how it failed
+static std::map<uint32_t, std::string>
+ReadStatus (std::string manifestName)
+{
+  std::map<uint32_t, std::string> status;
+  std::ifstream manifest (manifestName.c_str ());
+  std::string line;
+  while (std::getline (manifest, line))
+    {
+      std::vector<std::string> fields = Split (line, '\t');
+      char *end;
+      unsigned long run = fields.size () >= 2 ? std::strtoul (fields[0].c_str (), &end, 10) : 0;
+      // The header and torn lines have no run number
+      if (run > 0 && *end == '\0')
+        {
+          status[run] = fields[1];
+        }
+    }
+  return status;
+}
+
+/// Metrics of one finished replication, false if its results can't be read
+static bool
+ReadMetrics (std::string fileName, std::map<std::string, double> &metrics)
+{
+  ColumnFileReader reader;
+  if (!reader.Open (fileName))
+    {
+      return false;
+    }
+  int rxBytes = reader.FindColumn ("rxBytes");
+  int firstTx = reader.FindColumn ("timeFirstTxPacket");
+  int lastRx = reader.FindColumn ("timeLastRxPacket");
+  int delaySum = reader.FindColumn ("delaySum");
+  int txPackets = reader.FindColumn ("txPackets");
+  int rxPackets = reader.FindColumn ("rxPackets");
+  int lostPackets = reader.FindColumn ("lostPackets");
+  if (rxBytes < 0 || firstTx < 0 || lastRx < 0 || delaySum < 0 || txPackets < 0 || rxPackets < 0 || lostPackets < 0)
+    {
+      std::cerr << "Error: " << fileName << " lacks the per-flow columns\n";
+      return false;
+    }
+
+  double throughput = 0;
+  uint32_t flows = 0;
+  double delay = 0;
+  double tx = 0;
+  double rx = 0;
+  double lost = 0;
+  for (uint64_t row = 0; row < reader.GetNRows (); ++row)
+    {
+      double duration = reader.GetValue (lastRx, row) - reader.GetValue (firstTx, row);
+      if (duration > 0)
+        {
+          throughput += reader.GetValue (rxBytes, row) * 8.0 / duration / 1024;
+          flows++;
+        }
+      delay += reader.GetValue (delaySum, row);
+      tx += reader.GetValue (txPackets, row);
+      rx += reader.GetValue (rxPackets, row);
+      lost += reader.GetValue (lostPackets, row);
+    }
+  metrics["throughput"] = flows > 0 ? throughput / flows : 0;
+  metrics["delay"] = rx > 0 ? delay / rx : 0;
+  metrics["loss"] = tx > 0 ? lost / tx : 0;
+  return true;
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string program = "build/scratch/mesh-internet-handoff";
+  std::string out = "resultados/replications";
+  std::string extra = "";
+  std::string metricList = "throughput,delay";
+  double target = 0.05;
+  uint32_t minRuns = 5;
+  uint32_t maxRuns = 100;
+  uint32_t jobs = sysconf (_SC_NPROCESSORS_ONLN);
+
+  CommandLine cmd;
+  cmd.AddValue ("program", "Scenario binary to replicate", program);
+  cmd.AddValue ("out", "Directory for the replications and the summary", out);
+  cmd.AddValue ("jobs", "Replications executing at the same time, one per core by default", jobs);
+  cmd.AddValue ("extra", "Space separated options passed unchanged to every replication", extra);
+  cmd.AddValue ("metrics", "Comma separated metrics that must converge: throughput, delay, loss", metricList);
+  cmd.AddValue ("target", "Stop once every 95% confidence half-width is under this fraction of its mean", target);
+  cmd.AddValue ("min-runs", "Replications done before the stop rule is checked", minRuns);
+  cmd.AddValue ("max-runs", "Replications started at most", maxRuns);
+  cmd.Parse (argc, argv);
+  jobs = std::max<uint32_t> (jobs, 1);
+  minRuns = std::max<uint32_t> (minRuns, 2);
+
+  std::vector<std::string> metrics = Split (metricList, ',');
+  for (uint32_t m = 0; m < metrics.size (); ++m)
+    {
+      if (metrics[m] != "throughput" && metrics[m] != "delay" && metrics[m] != "loss")
+        {
+          std::cerr << "Error: Unknown metric " << metrics[m] << "\n";
+          return 1;
+        }
+    }
+  if (mkdir (out.c_str (), 0755) != 0 && errno != EEXIST)
+    {
+      std::cerr << "Error: Can't create " << out << "\n";
+      return 1;
+    }
+  // Replications run in their own directory, the paths they get must not be relative
+  char cwd[4096];
+  if (getcwd (cwd, sizeof (cwd)) == 0)
+    {
+      std::cerr << "Error: Can't read the working directory\n";
+      return 1;
+    }
+  if (program[0] != '/')
+    {
+      program = std::string (cwd) + "/" + program;
+    }
+  if (out[0] != '/')
+    {
+      out = std::string (cwd) + "/" + out;
+    }
+
+  std::string manifestName = out + "/replications.tsv";
+  std::map<uint32_t, std::string> status = ReadStatus (manifestName);
+  bool newManifest = !FileExists (manifestName);
+  std::ofstream manifest (manifestName.c_str (), std::ios::out | std::ios::app);
+  if (newManifest)
+    {
+      manifest << "run\tstatus\twall (s)\tpeak RSS (KB)\tthroughput (Kbps)\tdelay (s)\tloss\n";
+    }
+
+  std::map<std::string, Estimate> estimates;
+  uint32_t done = 0;
+  uint32_t failed = 0;
+
+  // Replications kept from an earlier start, whatever gaps there are between them
+  std::vector<bool> finished (maxRuns + 1, false);
+  std::vector<uint32_t> dirs = FindRunDirs (out);
+  for (uint32_t i = 0; i < dirs.size () && dirs[i] <= maxRuns; ++i)
+    {
+      uint32_t run = dirs[i];
+      std::map<uint32_t, std::string>::const_iterator s = status.find (run);
+      if (s == status.end ())
+        {
+          continue;
+        }
+      std::map<std::string, double> values;
+      if (s->second == "ok" && ReadMetrics (RunDir (out, run) + "/result.cols", values))
+        {
+          for (std::map<std::string, double>::const_iterator it = values.begin (); it != values.end (); ++it)
+            {
+              AddSample (estimates[it->first], it->second);
+            }
+          done++;
+        }
+      else
+        {
+          failed++;
+        }
+      finished[run] = true;
+    }
+  std::vector<uint32_t> pending;
+  for (uint32_t run = maxRuns; run > 0; --run)
+    {
+      if (!finished[run])
+        {
+          pending.push_back (run);
+        }
+    }
+  std::cout << done << " replications already done, " << failed << " failed, " << jobs << " jobs" << std::endl;
+
+  std::vector<std::string> extraArgs = Split (extra, ' ');
+  std::map<pid_t, std::pair<uint32_t, double> > running;
+  bool converged = false;
+  while (true)
+    {
+      converged = done >= minRuns;
+      for (uint32_t m = 0; m < metrics.size (); ++m)
+        {
+          const Estimate &e = estimates[metrics[m]];
+          converged = converged && HalfWidth (e) <= target * std::fabs (e.mean);
+        }
+
+      while (!converged && !pending.empty () && running.size () < jobs)
+        {
+          uint32_t run = pending.back ();
+          pending.pop_back ();
+          std::string dir = RunDir (out, run);
+          if (mkdir (dir.c_str (), 0755) != 0 && errno != EEXIST)
+            {
+              std::cerr << "Error: Can't create " << dir << "\n";
+              failed++;
+              continue;
+            }
+          std::ostringstream runArg;
+          runArg << "--run=" << run;
+          std::vector<std::string> args;
+          args.push_back (runArg.str ());
+          args.push_back ("--result-file=" + dir + "/result.cols");
+          args.insert (args.end (), extraArgs.begin (), extraArgs.end ());
+
+          pid_t pid = Launch (program, args, dir, "output.log");
+          if (pid < 0)
+            {
+              std::cerr << "Error: fork failed for run " << run << "\n";
+              pending.push_back (run);
+              break;
+            }
+          running[pid] = std::make_pair (run, NowSeconds ());
+        }
+      if (running.empty ())
+        {
+          break;
+        }
+
+      int status;
+      struct rusage usage;
+      pid_t pid = wait4 (-1, &status, 0, &usage);
+      if (pid < 0)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+          break;
+        }
+      std::map<pid_t, std::pair<uint32_t, double> >::iterator it = running.find (pid);
+      if (it == running.end ())
+        {
+          continue;
+        }
+      uint32_t run = it->second.first;
+      double wall = NowSeconds () - it->second.second;
+      running.erase (it);
+
+      std::map<std::string, double> values;
+      std::ostringstream result;
+      if (WIFEXITED (status) && WEXITSTATUS (status) == 0 && ReadMetrics (RunDir (out, run) + "/result.cols", values))
+        {
+          result << "ok";
+          for (std::map<std::string, double>::const_iterator v = values.begin (); v != values.end (); ++v)
+            {
+              AddSample (estimates[v->first], v->second);
+            }
+          done++;
+        }
+      else
+        {
+          failed++;
+          if (WIFSIGNALED (status))
+            {
+              result << "signal " << WTERMSIG (status);
+            }
+          else
+            {
+              result << "exit " << WEXITSTATUS (status);
+            }
+        }
+
+      manifest << run << "\t" << result.str () << "\t" << wall << "\t" << usage.ru_maxrss;
+      if (values.empty ())
+        {
+          manifest << "\t\t\t\n";
+        }
+      else
+        {
+          manifest << "\t" << values["throughput"] << "\t" << values["delay"] << "\t" << values["loss"] << "\n";
+        }
+      manifest.flush ();
+
+      std::cout << "run " << run << ": " << result.str () << ", " << wall << " s";
+      for (uint32_t m = 0; m < metrics.size (); ++m)
+        {
+          const Estimate &e = estimates[metrics[m]];
+          std::cout << ", " << metrics[m] << " " << e.mean << " +- " << HalfWidth (e);
+        }
+      std::cout << std::endl;
+    }
+  manifest.close ();
+
+  std::cout << done << " replications, " << failed << " failed, "
+            << (converged ? "converged" : "not converged") << std::endl;
+  std::cout << "metric\tmean\t95% half-width\trelative" << std::endl;
+  for (uint32_t m = 0; m < metrics.size (); ++m)
+    {
+      const Estimate &e = estimates[metrics[m]];
+      std::cout << metrics[m] << "\t" << e.mean << "\t" << HalfWidth (e) << "\t"
+                << (e.mean != 0 ? HalfWidth (e) / std::fabs (e.mean) : 0) << std::endl;
+    }
+  return converged ? 0 : 1;
+}
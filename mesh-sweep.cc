@@ -0,0 +1,332 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Parallel parameter sweep over basev5-aodv_original.
+ *
+ * The comma separated values of --mesh-width, --mesh-height,
+ * --node-distance and --app-tx-rate are expanded into their full grid, and
+ * each point is run as its own process of --program, at most --jobs at a
+ * time. Every run writes its flows to <out>/run-<n>.cols (see column-file.h)
+ * and its output to <out>/run-<n>.log.
+ *
+ * <out>/sweep.tsv gets one line per finished run: parameters, exit status,
+ * wall time and peak RSS. A run counts as done once its .cols file exists,
+ * which is only renamed into place when complete, and the parameters in its
+ * footer match the point's values, so a killed or crashed sweep is resumed
+ * by starting it again with the same options. Failed runs, and runs left
+ * over from a sweep over other values, are run again on the next start.
+ * When every point is done the run files are merged into <out>/sweep.cols,
+ * with a "run" column added.
+ *
+ *   ./waf --run "mesh-sweep --program=build/scratch/basev5-aodv_original
+ *                --mesh-width=3,4,5 --mesh-height=3,4,5 --app-tx-rate=64kbps,128kbps"
+ */
+
+#include "ns3/core-module.h"
+#include "column-file.h"
+#include "process-runner.h"
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("MeshSweep");
+
+struct SweepPoint
+{
+  std::vector<std::string> values;
+};
+
+static std::string
+RunName (std::string out, uint32_t run, std::string extension)
+{
+  std::ostringstream name;
+  name << out << "/run-" << run << extension;
+  return name.str ();
+}
+
+/// Whether the footer of the run file holds the values of point
+static bool
+IsDone (std::string fileName, const std::vector<std::string> &names, const SweepPoint &point)
+{
+  ColumnFileReader reader;
+  if (!FileExists (fileName) || !reader.Open (fileName))
+    {
+      return false;
+    }
+  for (uint32_t p = 0; p < names.size (); ++p)
+    {
+      std::string stored = reader.GetParameter (names[p]);
+      if (stored == point.values[p])
+        {
+          continue;
+        }
+      // Numbers are written back by the scenario, "75.0" may come back as "75"
+      char *storedEnd;
+      char *valueEnd;
+      double storedValue = std::strtod (stored.c_str (), &storedEnd);
+      double value = std::strtod (point.values[p].c_str (), &valueEnd);
+      if (stored.empty () || *storedEnd != '\0' || *valueEnd != '\0' || storedValue != value)
+        {
+          return false;
+        }
+    }
+  return true;
+}
+
+static void
+Merge (std::string out, uint32_t nRuns)
+{
+  ColumnFileWriter merged;
+  std::vector<uint32_t> columns;
+  uint32_t runColumn = 0;
+  ColumnFileReader reader;
+  for (uint32_t run = 0; run < nRuns; ++run)
+    {
+      if (!reader.Open (RunName (out, run, ".cols")))
+        {
+          continue;
+        }
+      if (columns.empty ())
+        {
+          runColumn = merged.AddColumn ("run", ColumnFileWriter::UINT32);
+          for (uint32_t c = 0; c < reader.GetNColumns (); ++c)
+            {
+              columns.push_back (merged.AddColumn (reader.GetColumnName (c), reader.GetColumnType (c)));
+            }
+        }
+      if (reader.GetNColumns () != columns.size ())
+        {
+          std::cerr << "Error: " << RunName (out, run, ".cols") << " has a different schema, not merged\n";
+          continue;
+        }
+      for (uint64_t row = 0; row < reader.GetNRows (); ++row)
+        {
+          merged.AppendUint (runColumn, run);
+          for (uint32_t c = 0; c < columns.size (); ++c)
+            {
+              if (reader.GetColumnType (c) == ColumnFileWriter::DOUBLE)
+                {
+                  merged.AppendDouble (columns[c], reader.GetDouble (c)[row]);
+                }
+              else if (reader.GetColumnType (c) == ColumnFileWriter::UINT32)
+                {
+                  merged.AppendUint (columns[c], reader.GetUint32 (c)[row]);
+                }
+              else
+                {
+                  merged.AppendUint (columns[c], reader.GetUint64 (c)[row]);
+                }
+            }
+        }
+    }
+  reader.Close ();
+  merged.SetParameter ("sweep-manifest", out + "/sweep.tsv");
+  merged.Write (out + "/sweep.cols");
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string program = "build/scratch/basev5-aodv_original";
+  std::string out = "resultados/sweep";
+  std::string extra = "";
+  uint32_t jobs = sysconf (_SC_NPROCESSORS_ONLN);
+  std::vector<std::string> names;
+  names.push_back ("mesh-width");
+  names.push_back ("mesh-height");
+  names.push_back ("node-distance");
+  names.push_back ("app-tx-rate");
+  std::vector<std::string> lists;
+  lists.push_back ("3");
+  lists.push_back ("3");
+  lists.push_back ("75");
+  lists.push_back ("128kbps");
+
+  CommandLine cmd;
+  cmd.AddValue ("program", "Scenario binary run for every point", program);
+  cmd.AddValue ("out", "Directory for run files, logs and the merged results", out);
+  cmd.AddValue ("jobs", "Runs executing at the same time, one per core by default", jobs);
+  cmd.AddValue ("extra", "Space separated options passed unchanged to every run", extra);
+  for (uint32_t p = 0; p < names.size (); ++p)
+    {
+      cmd.AddValue (names[p], "Comma separated values of " + names[p], lists[p]);
+    }
+  cmd.Parse (argc, argv);
+  jobs = std::max<uint32_t> (jobs, 1);
+
+  if (mkdir (out.c_str (), 0755) != 0 && errno != EEXIST)
+    {
+      std::cerr << "Error: Can't create " << out << "\n";
+      return 1;
+    }
+
+  // Expand the grid, the last parameter varying fastest
+  std::vector<std::vector<std::string> > values;
+  for (uint32_t p = 0; p < lists.size (); ++p)
+    {
+      values.push_back (Split (lists[p], ','));
+    }
+  std::vector<SweepPoint> points (1);
+  for (uint32_t p = 0; p < values.size (); ++p)
+    {
+      std::vector<SweepPoint> expanded;
+      for (uint32_t i = 0; i < points.size (); ++i)
+        {
+          for (uint32_t v = 0; v < values[p].size (); ++v)
+            {
+              SweepPoint point = points[i];
+              point.values.push_back (values[p][v]);
+              expanded.push_back (point);
+            }
+        }
+      points.swap (expanded);
+    }
+
+  std::vector<uint32_t> pending;
+  for (uint32_t run = points.size (); run-- > 0; )
+    {
+      if (!IsDone (RunName (out, run, ".cols"), names, points[run]))
+        {
+          if (FileExists (RunName (out, run, ".cols")))
+            {
+              std::cout << "run " << run << ": " << RunName (out, run, ".cols")
+                        << " holds other parameters, running it again" << std::endl;
+            }
+          pending.push_back (run);
+        }
+    }
+  std::cout << points.size () << " points, " << points.size () - pending.size () << " already done, "
+            << jobs << " jobs" << std::endl;
+
+  std::string manifestName = out + "/sweep.tsv";
+  bool newManifest = !FileExists (manifestName);
+  std::ofstream manifest (manifestName.c_str (), std::ios::out | std::ios::app);
+  if (newManifest)
+    {
+      manifest << "run";
+      for (uint32_t p = 0; p < names.size (); ++p)
+        {
+          manifest << "\t" << names[p];
+        }
+      manifest << "\tstatus\twall (s)\tpeak RSS (KB)\n";
+    }
+
+  std::vector<std::string> extraArgs = Split (extra, ' ');
+  std::map<pid_t, std::pair<uint32_t, double> > running;
+  uint32_t failed = 0;
+  while (!pending.empty () || !running.empty ())
+    {
+      while (!pending.empty () && running.size () < jobs)
+        {
+          uint32_t run = pending.back ();
+          pending.pop_back ();
+          std::vector<std::string> args;
+          for (uint32_t p = 0; p < names.size (); ++p)
+            {
+              args.push_back ("--" + names[p] + "=" + points[run].values[p]);
+            }
+          args.push_back ("--stats-file=" + RunName (out, run, ""));
+          args.push_back ("--flow-file=" + RunName (out, run, ".flowmon"));
+          args.push_back ("--result-file=" + RunName (out, run, ".cols"));
+          args.insert (args.end (), extraArgs.begin (), extraArgs.end ());
+
+          pid_t pid = Launch (program, args, "", RunName (out, run, ".log"));
+          if (pid < 0)
+            {
+              std::cerr << "Error: fork failed for run " << run << "\n";
+              pending.push_back (run);
+              break;
+            }
+          running[pid] = std::make_pair (run, NowSeconds ());
+        }
+
+      int status;
+      struct rusage usage;
+      pid_t pid = wait4 (-1, &status, 0, &usage);
+      if (pid < 0)
+        {
+          if (errno == EINTR)
+            {
+              continue;
+            }
+          break;
+        }
+      std::map<pid_t, std::pair<uint32_t, double> >::iterator it = running.find (pid);
+      if (it == running.end ())
+        {
+          continue;
+        }
+      uint32_t run = it->second.first;
+      double wall = NowSeconds () - it->second.second;
+      running.erase (it);
+
+      std::ostringstream result;
+      if (WIFEXITED (status) && WEXITSTATUS (status) == 0 && FileExists (RunName (out, run, ".cols")))
+        {
+          result << "ok";
+        }
+      else
+        {
+          failed++;
+          if (WIFSIGNALED (status))
+            {
+              result << "signal " << WTERMSIG (status);
+            }
+          else
+            {
+              result << "exit " << WEXITSTATUS (status);
+            }
+        }
+
+      manifest << run;
+      for (uint32_t p = 0; p < names.size (); ++p)
+        {
+          manifest << "\t" << points[run].values[p];
+        }
+      manifest << "\t" << result.str () << "\t" << wall << "\t" << usage.ru_maxrss << "\n";
+      manifest.flush ();
+      std::cout << "run " << run << ": " << result.str () << ", " << wall << " s, " << usage.ru_maxrss << " KB, "
+                << pending.size () + running.size () << " left" << std::endl;
+    }
+  manifest.close ();
+
+  if (failed > 0 || !pending.empty ())
+    {
+      failed += pending.size ();
+      std::cout << failed << " runs failed, start the sweep again to retry them" << std::endl;
+      return 1;
+    }
+  Merge (out, points.size ());
+  std::cout << "Merged results in " << out << "/sweep.cols" << std::endl;
+  return 0;
+}
@@ -14,7 +14,8 @@
 #include "ns3/point-to-point-module.h"
 #include "ns3/netanim-module.h"
 
-#include "mesh-tcp.h"
+#include "myapp.h"
+#include "flow-matrix.h"
 
 #include <iostream>
 #include <sstream>
@@ -26,7 +27,7 @@ using namespace ns3;
 
 //-----------------------------------FUNCTIONS FOR CREATING SOCKETS
 
-void createTcpSocket(NodeContainer c, Ipv4InterfaceContainer ifcont, int sink, int source, int sinkPort, double startTime, double stopTime, uint32_t packetSize, uint32_t numPackets, std::string dataRate)
+Ptr<MyApp> createTcpSocket(const NodeContainer &c, const Ipv4InterfaceContainer &ifcont, int sink, int source, int sinkPort, double startTime, double stopTime, uint32_t packetSize, uint32_t numPackets, std::string dataRate)
 {
 	
 	Address sinkAddress1 (InetSocketAddress (ifcont.GetAddress (sink), sinkPort));
@@ -38,13 +39,15 @@ void createTcpSocket(NodeContainer c, Ipv4InterfaceContainer ifcont, int sink, i
 	Ptr<Socket> ns3TcpSocket1 = Socket::CreateSocket (c.Get (source), TcpSocketFactory::GetTypeId ());
 	Ptr<MyApp> app1 = CreateObject<MyApp> ();
 	app1->Setup (ns3TcpSocket1, sinkAddress1, packetSize, numPackets, DataRate (dataRate));
+	app1->SetBackpressure (true);
 	c.Get (source)->AddApplication (app1);
 	app1->SetStartTime (Seconds (startTime));
 	app1->SetStopTime (Seconds (stopTime));
 	
+	return app1;
 }
 
-void createUdpSocket(NodeContainer c, Ipv4InterfaceContainer ifcont, int sink, int source, int sinkPort, double startTime, double stopTime, uint32_t packetSize, uint32_t numPackets, std::string dataRate)
+void createUdpSocket(const NodeContainer &c, const Ipv4InterfaceContainer &ifcont, int sink, int source, int sinkPort, double startTime, double stopTime, uint32_t packetSize, uint32_t numPackets, std::string dataRate)
 {
 	
 	Address sinkAddress1 (InetSocketAddress (ifcont.GetAddress (sink), sinkPort));
@@ -79,6 +82,11 @@ int main (int argc, char *argv[])
 {
          //LogComponentEnable ("YansWifiPhy", LOG_LEVEL_ALL);
 	uint32_t packetSize = 1024;
+	std::string flowMatrix = "";
+	
+	CommandLine cmd;
+	cmd.AddValue ("flowMatrix", "CSV or binary flow matrix installed instead of the single TCP flow", flowMatrix);
+	cmd.Parse (argc, argv);
         
         ns3::PacketMetadata::Enable ();
 	
@@ -190,9 +198,24 @@ int main (int argc, char *argv[])
 	Ipv4InterfaceContainer genInterfaces;
 	genInterfaces = address.Assign (genMeshDevice);
 	
-	//-----------------------------------CREATE A TCP SOCKET
+	//-----------------------------------CREATE A TCP SOCKET OR INSTALL THE FLOW MATRIX
 	
-	createTcpSocket(genMesh, genInterfaces, 1, 0, 8080, 1.0, 100.0, packetSize, 1000, "250Kbps");
+	Ptr<MyApp> tcpApp;
+	if (flowMatrix.empty ())
+    {
+		tcpApp = createTcpSocket(genMesh, genInterfaces, 1, 0, 8080, 1.0, 100.0, packetSize, 1000, "250Kbps");
+    }
+	else
+    {
+		FlowMatrixHelper matrix;
+		if (!matrix.Load (flowMatrix))
+        {
+			return 1;
+        }
+		matrix.Install (genMesh, genInterfaces);
+		NS_LOG_UNCOND("Flow matrix: " << matrix.GetNFlows () << " flows, " << matrix.GetNSinks () << " sinks, loaded in "
+		              << matrix.GetLoadTime () << " ms, installed in " << matrix.GetInstallTime () << " ms");
+    }
 	
 	//-----------------------------------INSTALL FLOWMONITOR
 	
@@ -218,6 +241,18 @@ int main (int argc, char *argv[])
 		NS_LOG_UNCOND("Throughput: " << iter->second.rxBytes * 8.0 / (iter->second.timeLastRxPacket.GetSeconds()-iter->second.timeFirstTxPacket.GetSeconds()) / packetSize  << " Kbps");
     }
 	
+	//-----------------------------------BYTES ACCEPTED BY THE TCP SOCKET
+	
+	if (tcpApp)
+    {
+		const std::vector<uint64_t> &accepted = tcpApp->GetAcceptedPerSecond ();
+		for (uint32_t i = 0; i < accepted.size (); ++i)
+        {
+			NS_LOG_UNCOND("Second " << i + 1 << " accepted " << accepted[i] << " bytes");
+        }
+		NS_LOG_UNCOND("Total accepted: " << tcpApp->GetBytesAccepted () << " bytes");
+    }
+	
 	Simulator::Destroy ();
 	return 0;
 	
@@ -0,0 +1,96 @@
+#ifndef PROCESS_RUNNER_H
+#define PROCESS_RUNNER_H
+
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <stdint.h>
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+
+/*
+ * Helpers for the drivers that run scenarios as child processes
+ * (mesh-sweep, mesh-replicate and scenario-bench).
+ *
+ * Launch () only forks and execs; reaping the child with wait4 (), and
+ * turning its exit status into a result, is left to the caller.
+ */
+
+/// Non-empty fields of list
+inline std::vector<std::string>
+Split (std::string list, char separator)
+{
+  std::vector<std::string> values;
+  std::istringstream in (list);
+  std::string value;
+  while (std::getline (in, value, separator))
+    {
+      if (!value.empty ())
+        {
+          values.push_back (value);
+        }
+    }
+  return values;
+}
+
+/// Wall clock time in seconds
+inline double
+NowSeconds (void)
+{
+  struct timeval tv;
+  gettimeofday (&tv, 0);
+  return tv.tv_sec + tv.tv_usec / 1e6;
+}
+
+inline bool
+FileExists (std::string fileName)
+{
+  struct stat st;
+  return stat (fileName.c_str (), &st) == 0;
+}
+
+/**
+ * Start program in the background, returns its pid or -1.
+ *
+ * The child changes into dir unless it is empty, and sends its stdout and
+ * stderr to logFile, relative to dir. It exits with 126 if dir can't be
+ * entered and 127 if program can't be run.
+ */
+inline pid_t
+Launch (std::string program, const std::vector<std::string> &args, std::string dir, std::string logFile)
+{
+  pid_t pid = fork ();
+  if (pid != 0)
+    {
+      return pid;
+    }
+
+  if (!dir.empty () && chdir (dir.c_str ()) != 0)
+    {
+      _exit (126);
+    }
+  int log = open (logFile.c_str (), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (log >= 0)
+    {
+      dup2 (log, STDOUT_FILENO);
+      dup2 (log, STDERR_FILENO);
+      close (log);
+    }
+  std::vector<char *> argv;
+  argv.push_back (const_cast<char *> (program.c_str ()));
+  for (uint32_t i = 0; i < args.size (); ++i)
+    {
+      argv.push_back (const_cast<char *> (args[i].c_str ()));
+    }
+  argv.push_back (0);
+  execv (program.c_str (), &argv[0]);
+  std::perror ("execv");
+  _exit (127);
+}
+
+#endif /* PROCESS_RUNNER_H */
@@ -0,0 +1,122 @@
+#ifndef RNG_STREAMS_H
+#define RNG_STREAMS_H
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/mobility-module.h"
+#include "ns3/applications-module.h"
+#include "traffic-app.h"
+
+using namespace ns3;
+
+/*
+ * RngStreams gives the random variables of a scenario fixed ns-3 RNG
+ * streams, so a run only depends on the seed and the run (replication)
+ * number.
+ *
+ * Left alone, ns-3 numbers streams in the order the variables happen to be
+ * created. Here the scenario hands its helpers and nodes over in a fixed
+ * order once everything is installed, and each gets the next block of
+ * streams. The run number then selects an independent substream of every
+ * stream, so replications can be run in any order, in any number of
+ * processes, and each one is reproduced exactly by its (seed, run) pair.
+ *
+ *   m_streams.Assign (meshHelper, meshDevices);
+ *   m_streams.Assign (routingProtocol, nc_mesh);
+ *   m_streams.AssignNodes (NodeContainer::GetGlobal ());
+ */
+class RngStreams
+{
+public:
+
+  RngStreams (int64_t first = 0);
+
+  /// Select the replication, a run of 0 keeps --RngRun. Call before any variable is drawn from
+  static void SetRun (uint64_t run);
+
+  /// Streams of a device helper (WifiHelper, MeshHelper) for its devices
+  template <class Helper>
+  void Assign (Helper &helper, NetDeviceContainer devices);
+  /// Streams of a node helper (InternetStackHelper, OlsrHelper, AodvHelper) for its nodes
+  template <class Helper>
+  void Assign (Helper &helper, NodeContainer nodes);
+  /// Streams of the mobility models, OnOff applications and TrafficApps of nodes
+  void AssignNodes (NodeContainer nodes);
+  /// A single stream, for a variable owned by the scenario itself
+  int64_t Allocate (void);
+
+  /// First stream not handed out yet
+  int64_t GetNext (void) const;
+
+private:
+  int64_t m_next;
+};
+
+RngStreams::RngStreams (int64_t first)
+  : m_next (first)
+{
+}
+
+void
+RngStreams::SetRun (uint64_t run)
+{
+  if (run > 0)
+    {
+      RngSeedManager::SetRun (run);
+    }
+}
+
+template <class Helper>
+void
+RngStreams::Assign (Helper &helper, NetDeviceContainer devices)
+{
+  m_next += helper.AssignStreams (devices, m_next);
+}
+
+template <class Helper>
+void
+RngStreams::Assign (Helper &helper, NodeContainer nodes)
+{
+  m_next += helper.AssignStreams (nodes, m_next);
+}
+
+void
+RngStreams::AssignNodes (NodeContainer nodes)
+{
+  for (NodeContainer::Iterator n = nodes.Begin (); n != nodes.End (); ++n)
+    {
+      Ptr<MobilityModel> mobility = (*n)->GetObject<MobilityModel> ();
+      if (mobility)
+        {
+          m_next += mobility->AssignStreams (m_next);
+        }
+      for (uint32_t i = 0; i < (*n)->GetNApplications (); ++i)
+        {
+          Ptr<Application> application = (*n)->GetApplication (i);
+          Ptr<OnOffApplication> onoff = DynamicCast<OnOffApplication> (application);
+          if (onoff)
+            {
+              m_next += onoff->AssignStreams (m_next);
+            }
+          Ptr<TrafficAppBase> traffic = DynamicCast<TrafficAppBase> (application);
+          if (traffic)
+            {
+              m_next += traffic->AssignStreams (m_next);
+            }
+        }
+    }
+}
+
+int64_t
+RngStreams::Allocate (void)
+{
+  return m_next++;
+}
+
+int64_t
+RngStreams::GetNext (void) const
+{
+  return m_next;
+}
+
+#endif /* RNG_STREAMS_H */
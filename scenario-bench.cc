@@ -0,0 +1,481 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Performance benchmark of the scratch scenarios.
+ *
+ * Every scenario of the suite is run --repeat times, one at a time, with
+ * pinned parameters and seeds, in its own directory <out>/<name>. Each run
+ * reports its events, setup and run time through --bench-file (see
+ * bench-report.h), and the fastest repetition is kept. The results are
+ * written as JSON to --json, one scenario per line:
+ *
+ *   {"name": "fat-tree", "status": "ok", "events": 1234, "events_per_sec": 5e+06,
+ *    "setup_s": 0.01, "run_s": 0.0002, "wall_s": 0.05, "peak_rss_kb": 20480}
+ *
+ * With --compare=<file>, an earlier output of scenario-bench, every metric is
+ * compared with that baseline and changes worse than --threshold (a
+ * fraction) are flagged as regressions; the program then exits with 1.
+ *
+ *   ./waf --run "scenario-bench --json=bench-new.json --compare=bench-old.json"
+ *
+ * With --schedulers, every scenario is run once per event scheduler (see
+ * ladder-scheduler.h) under the name <scenario>:<scheduler>, and the event
+ * rates are tabled against the first scheduler. All schedulers must run the
+ * same events; a scenario where they don't is flagged.
+ *
+ *   ./waf --run "scenario-bench --schedulers=map,heap,calendar,ladder"
+ */
+
+#include "ns3/core-module.h"
+#include "process-runner.h"
+
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("ScenarioBench");
+
+struct BenchScenario
+{
+  std::string name;
+  std::string program;
+  std::string args;
+};
+
+struct BenchResult
+{
+  BenchResult () : ok (false) {}
+  bool ok;
+  std::string status;
+  std::map<std::string, double> values;
+};
+
+static const char *g_metrics[] = { "events", "events_per_sec", "setup_s", "run_s", "wall_s", "peak_rss_kb" };
+static const uint32_t g_nMetrics = sizeof (g_metrics) / sizeof (g_metrics[0]);
+
+/// Scenarios and their pinned parameters, seed and run
+static std::vector<BenchScenario>
+Suite (void)
+{
+  std::vector<BenchScenario> suite;
+  BenchScenario s;
+  s.name = "fat-tree";
+  s.args = "--RngSeed=1 --RngRun=1";
+  suite.push_back (s);
+  s.name = "basev5-aodv_original";
+  s.args = "--RngSeed=1 --run=1 --mesh-width=3 --mesh-height=3 --time=60 --stats-file=bench --flow-file=bench.flowmon";
+  suite.push_back (s);
+  s.name = "infrastructure-mesh-backbone";
+  s.args = "--RngSeed=1 --run=1 --x-size=3 --y-size=3 --time=30";
+  suite.push_back (s);
+  s.name = "lab-2-solved";
+  s.args = "--RngSeed=1 --RngRun=1";
+  suite.push_back (s);
+  s.name = "imesh-tcp-handover";
+  s.args = "--RngSeed=1 --run=1 --time=30 --pcap=0";
+  suite.push_back (s);
+  for (uint32_t i = 0; i < suite.size (); ++i)
+    {
+      suite[i].program = suite[i].name;
+    }
+  return suite;
+}
+
+/// Value of "key": in one line of JSON written by BenchReport or scenario-bench
+static bool
+FindNumber (const std::string &line, std::string key, double &value)
+{
+  std::string::size_type pos = line.find ("\"" + key + "\": ");
+  if (pos == std::string::npos)
+    {
+      return false;
+    }
+  value = std::strtod (line.c_str () + pos + key.size () + 4, 0);
+  return true;
+}
+
+static std::string
+FindString (const std::string &line, std::string key)
+{
+  std::string::size_type pos = line.find ("\"" + key + "\": \"");
+  if (pos == std::string::npos)
+    {
+      return "";
+    }
+  pos += key.size () + 5;
+  return line.substr (pos, line.find ('"', pos) - pos);
+}
+
+/// Run program in dir until it exits, false if it failed
+static bool
+RunOnce (std::string program, const std::vector<std::string> &args, std::string dir,
+         double &wall, long &peakRss, std::string &status)
+{
+  double start = NowSeconds ();
+  pid_t pid = Launch (program, args, dir, "output.log");
+  if (pid < 0)
+    {
+      status = "fork failed";
+      return false;
+    }
+
+  int exitStatus;
+  struct rusage usage;
+  while (wait4 (pid, &exitStatus, 0, &usage) < 0)
+    {
+      if (errno != EINTR)
+        {
+          status = "wait failed";
+          return false;
+        }
+    }
+  wall = NowSeconds () - start;
+  peakRss = usage.ru_maxrss;
+
+  std::ostringstream result;
+  if (WIFSIGNALED (exitStatus))
+    {
+      result << "signal " << WTERMSIG (exitStatus);
+    }
+  else if (WEXITSTATUS (exitStatus) != 0)
+    {
+      result << "exit " << WEXITSTATUS (exitStatus);
+    }
+  else
+    {
+      result << "ok";
+    }
+  status = result.str ();
+  return status == "ok";
+}
+
+static BenchResult
+RunScenario (const BenchScenario &scenario, std::string buildDir, std::string out, uint32_t repeat)
+{
+  BenchResult best;
+  std::string dir = out + "/" + scenario.name;
+  if (mkdir (dir.c_str (), 0755) != 0 && errno != EEXIST)
+    {
+      best.status = "can't create " + dir;
+      return best;
+    }
+  std::vector<std::string> args = Split (scenario.args, ' ');
+  args.push_back ("--bench-file=bench.json");
+
+  for (uint32_t r = 0; r < repeat; ++r)
+    {
+      std::string benchFile = dir + "/bench.json";
+      std::remove (benchFile.c_str ());
+      double wall = 0;
+      long peakRss = 0;
+      std::string status;
+      if (!RunOnce (buildDir + "/" + scenario.program, args, dir, wall, peakRss, status))
+        {
+          BenchResult failed;
+          failed.status = status;
+          return failed;
+        }
+
+      std::ifstream in (benchFile.c_str ());
+      std::string line;
+      std::getline (in, line);
+      BenchResult result;
+      result.ok = true;
+      result.status = "ok";
+      for (uint32_t m = 0; m < g_nMetrics; ++m)
+        {
+          double value;
+          if (FindNumber (line, g_metrics[m], value))
+            {
+              result.values[g_metrics[m]] = value;
+            }
+        }
+      if (result.values.find ("events") == result.values.end ())
+        {
+          BenchResult failed;
+          failed.status = "no bench report";
+          return failed;
+        }
+      result.values["wall_s"] = wall;
+      // wait4 also covers what the scenario does after Finish ()
+      result.values["peak_rss_kb"] = peakRss;
+      if (!best.ok || wall < best.values["wall_s"])
+        {
+          best = result;
+        }
+    }
+  return best;
+}
+
+static std::string
+JsonLine (std::string name, const BenchResult &result)
+{
+  std::ostringstream line;
+  line << "{\"name\": \"" << name << "\", \"status\": \"" << result.status << "\"";
+  for (uint32_t m = 0; m < g_nMetrics; ++m)
+    {
+      std::map<std::string, double>::const_iterator it = result.values.find (g_metrics[m]);
+      if (it != result.values.end ())
+        {
+          line << ", \"" << g_metrics[m] << "\": " << it->second;
+        }
+    }
+  line << "}";
+  return line.str ();
+}
+
+static bool
+ReadBaseline (std::string fileName, std::map<std::string, BenchResult> &baseline)
+{
+  std::ifstream in (fileName.c_str ());
+  if (!in)
+    {
+      std::cerr << "Error: Can't open " << fileName << "\n";
+      return false;
+    }
+  std::string line;
+  while (std::getline (in, line))
+    {
+      std::string name = FindString (line, "name");
+      if (name.empty ())
+        {
+          continue;
+        }
+      BenchResult &result = baseline[name];
+      result.status = FindString (line, "status");
+      result.ok = result.status == "ok";
+      for (uint32_t m = 0; m < g_nMetrics; ++m)
+        {
+          double value;
+          if (FindNumber (line, g_metrics[m], value))
+            {
+              result.values[g_metrics[m]] = value;
+            }
+        }
+    }
+  return true;
+}
+
+/// Print the event rate of every scheduler against the first, returns the number of scenarios whose events differ
+static uint32_t
+CompareSchedulers (const std::vector<std::pair<std::string, BenchResult> > &results,
+                   const std::vector<std::string> &schedulers)
+{
+  std::cout << "\nscenario";
+  for (uint32_t k = 0; k < schedulers.size (); ++k)
+    {
+      std::cout << "\t" << schedulers[k];
+    }
+  std::cout << "\t(events/s, speedup over " << schedulers[0] << ")\n";
+
+  uint32_t different = 0;
+  for (uint32_t i = 0; i + schedulers.size () <= results.size (); i += schedulers.size ())
+    {
+      const BenchResult &first = results[i].second;
+      std::string name = results[i].first.substr (0, results[i].first.rfind (':'));
+      std::cout << name;
+      bool same = true;
+      for (uint32_t k = 0; k < schedulers.size (); ++k)
+        {
+          const BenchResult &result = results[i + k].second;
+          if (!result.ok || !first.ok)
+            {
+              std::cout << "\t" << result.status;
+              continue;
+            }
+          double rate = result.values.find ("events_per_sec")->second;
+          double base = first.values.find ("events_per_sec")->second;
+          std::cout << "\t" << rate << " (" << (base > 0 ? rate / base : 0) << "x)";
+          same = same && result.values.find ("events")->second == first.values.find ("events")->second;
+        }
+      std::cout << (same ? "" : "\tEVENTS DIFFER") << "\n";
+      different += same ? 0 : 1;
+    }
+  return different;
+}
+
+/// Print the comparison of one scenario, returns the number of regressions
+static uint32_t
+Compare (std::string name, const BenchResult &base, const BenchResult &current, double threshold)
+{
+  if (!current.ok)
+    {
+      std::cout << name << "\tstatus\t" << base.status << "\t" << current.status << "\t\tREGRESSION\n";
+      return 1;
+    }
+  uint32_t regressions = 0;
+  for (uint32_t m = 0; m < g_nMetrics; ++m)
+    {
+      std::string metric = g_metrics[m];
+      std::map<std::string, double>::const_iterator b = base.values.find (metric);
+      std::map<std::string, double>::const_iterator c = current.values.find (metric);
+      if (b == base.values.end () || c == current.values.end ())
+        {
+          continue;
+        }
+      double change = b->second != 0 ? (c->second - b->second) / b->second : 0;
+      std::string flag = "";
+      if (metric == "events")
+        {
+          // Not a cost, but the scenario no longer does the same work
+          flag = c->second != b->second ? "CHANGED" : "";
+        }
+      else if (metric == "events_per_sec" ? change < -threshold : change > threshold)
+        {
+          flag = "REGRESSION";
+          regressions++;
+        }
+      std::cout << name << "\t" << metric << "\t" << b->second << "\t" << c->second << "\t"
+                << change * 100 << "%\t" << flag << "\n";
+    }
+  return regressions;
+}
+
+int
+main (int argc, char *argv[])
+{
+  std::string buildDir = "build/scratch";
+  std::string out = "resultados/bench";
+  std::string json = "";
+  std::string compare = "";
+  std::string only = "";
+  std::string schedulerList = "";
+  double threshold = 0.10;
+  uint32_t repeat = 3;
+
+  CommandLine cmd;
+  cmd.AddValue ("build-dir", "Directory holding the scenario binaries", buildDir);
+  cmd.AddValue ("out", "Directory the scenarios run in", out);
+  cmd.AddValue ("json", "Write the results to this file, <out>/bench.json if empty", json);
+  cmd.AddValue ("compare", "Baseline results to compare with, none if empty", compare);
+  cmd.AddValue ("threshold", "Relative change counted as a regression", threshold);
+  cmd.AddValue ("repeat", "Runs of each scenario, the fastest one is kept", repeat);
+  cmd.AddValue ("only", "Comma separated scenarios to run, the whole suite if empty", only);
+  cmd.AddValue ("schedulers", "Comma separated event schedulers to run every scenario with, the default one if empty", schedulerList);
+  cmd.Parse (argc, argv);
+  repeat = std::max<uint32_t> (repeat, 1);
+
+  if (mkdir (out.c_str (), 0755) != 0 && errno != EEXIST)
+    {
+      std::cerr << "Error: Can't create " << out << "\n";
+      return 1;
+    }
+  // The scenarios run in their own directory, the binaries must not be relative
+  char cwd[4096];
+  if (buildDir[0] != '/' && getcwd (cwd, sizeof (cwd)) != 0)
+    {
+      buildDir = std::string (cwd) + "/" + buildDir;
+    }
+  if (json.empty ())
+    {
+      json = out + "/bench.json";
+    }
+  std::map<std::string, BenchResult> baseline;
+  if (!compare.empty () && !ReadBaseline (compare, baseline))
+    {
+      return 1;
+    }
+
+  std::vector<std::string> selected = Split (only, ',');
+  std::vector<std::string> schedulers = Split (schedulerList, ',');
+  std::vector<BenchScenario> suite = Suite ();
+  std::vector<std::pair<std::string, BenchResult> > results;
+  for (uint32_t i = 0; i < suite.size (); ++i)
+    {
+      if (!selected.empty () && std::find (selected.begin (), selected.end (), suite[i].name) == selected.end ())
+        {
+          continue;
+        }
+      std::vector<BenchScenario> runs;
+      runs.push_back (suite[i]);
+      if (!schedulers.empty ())
+        {
+          runs.clear ();
+          for (uint32_t k = 0; k < schedulers.size (); ++k)
+            {
+              BenchScenario run = suite[i];
+              run.name += ":" + schedulers[k];
+              run.args += " --scheduler=" + schedulers[k];
+              runs.push_back (run);
+            }
+        }
+      for (uint32_t k = 0; k < runs.size (); ++k)
+        {
+          BenchResult result = RunScenario (runs[k], buildDir, out, repeat);
+          std::cout << JsonLine (runs[k].name, result) << std::endl;
+          results.push_back (std::make_pair (runs[k].name, result));
+        }
+    }
+
+  std::ofstream of (json.c_str ());
+  if (!of)
+    {
+      std::cerr << "Error: Can't open " << json << "\n";
+      return 1;
+    }
+  of << "{\n  \"scenarios\": [\n";
+  for (uint32_t i = 0; i < results.size (); ++i)
+    {
+      of << "    " << JsonLine (results[i].first, results[i].second) << (i + 1 < results.size () ? ",\n" : "\n");
+    }
+  of << "  ]\n}\n";
+  of.close ();
+
+  uint32_t failed = 0;
+  for (uint32_t i = 0; i < results.size (); ++i)
+    {
+      failed += results[i].second.ok ? 0 : 1;
+    }
+  if (!schedulers.empty ())
+    {
+      failed += CompareSchedulers (results, schedulers);
+    }
+  if (compare.empty ())
+    {
+      return failed > 0 ? 1 : 0;
+    }
+
+  std::cout << "\nscenario\tmetric\tbaseline\tcurrent\tchange\n";
+  uint32_t regressions = 0;
+  for (uint32_t i = 0; i < results.size (); ++i)
+    {
+      std::map<std::string, BenchResult>::const_iterator base = baseline.find (results[i].first);
+      if (base == baseline.end ())
+        {
+          std::cout << results[i].first << "\t(not in baseline)\n";
+          continue;
+        }
+      regressions += Compare (results[i].first, base->second, results[i].second, threshold);
+    }
+  std::cout << regressions << " regressions over " << threshold * 100 << "%" << std::endl;
+  return regressions > 0 || failed > 0 ? 1 : 0;
+}
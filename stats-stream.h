@@ -0,0 +1,250 @@
+#ifndef STATS_STREAM_H
+#define STATS_STREAM_H
+
+#include "ns3/core-module.h"
+
+#include "async-writer.h"
+
+#include <cstdio>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+/*
+ * StatsStream is an append-only log of per-interval flow statistics, written
+ * while the simulation runs instead of rewriting a full FlowMonitor XML file.
+ *
+ * Records are formatted into a block buffer and reach the file only when the
+ * block is full or on Flush()/Close(). When opened with async set, full
+ * blocks are handed to an AsyncWriter and written by its thread; when its
+ * queue is full, Flush() waits for room rather than drop the block. Two
+ * layouts:
+ *
+ *   text:    a '#' header line, then one line per record
+ *            "<time s> <flow id> <rx bytes> <tx packets> <rx packets> <Mbps>"
+ *   binary:  header (16 bytes): char magic[8] = "NS3STATS", uint32 version = 1,
+ *                               uint32 record size = 32
+ *            record (32 bytes): uint64 time (ns), uint32 flow id, uint32 tx packets,
+ *                               uint64 rx bytes, uint32 rx packets, float Mbps
+ *            all little-endian.
+ */
+class StatsStream
+{
+public:
+
+  StatsStream ();
+  ~StatsStream ();
+
+  bool Open (std::string fileName, bool binary, uint32_t blockBytes = 1024 * 1024, bool async = false);
+  void Append (Time time, uint32_t flowId, uint64_t rxBytes, uint32_t txPackets, uint32_t rxPackets, double throughput);
+  void Flush (void);
+  void Close (void);
+
+  bool IsOpen (void) const;
+  uint64_t GetRecordsWritten (void) const;
+  uint64_t GetBytesWritten (void) const;
+
+  static const uint32_t HEADER_SIZE = 16;
+  static const uint32_t RECORD_SIZE = 32;
+  /// Longest text record
+  static const uint32_t MAX_LINE = 128;
+
+private:
+  void Reserve (uint32_t bytes);
+  static uint8_t *WriteLe32 (uint8_t *p, uint32_t v);
+  static uint8_t *WriteLe64 (uint8_t *p, uint64_t v);
+
+  std::FILE            *m_file;
+  AsyncWriter           m_async;
+  bool                  m_binary;
+  std::vector<uint8_t>  m_block;
+  uint32_t              m_used;
+  uint64_t              m_records;
+  uint64_t              m_bytes;
+};
+
+StatsStream::StatsStream ()
+  : m_file (0),
+    m_binary (false),
+    m_used (0),
+    m_records (0),
+    m_bytes (0)
+{
+}
+
+StatsStream::~StatsStream ()
+{
+  Close ();
+}
+
+bool
+StatsStream::Open (std::string fileName, bool binary, uint32_t blockBytes, bool async)
+{
+  Close ();
+  if (async)
+    {
+      // Room for a few blocks in flight
+      if (!m_async.Open (fileName, 4 * blockBytes))
+        {
+          return false;
+        }
+    }
+  else
+    {
+      m_file = std::fopen (fileName.c_str (), binary ? "wb" : "w");
+      if (!m_file)
+        {
+          std::cerr << "Error: Can't open " << fileName << "\n";
+          return false;
+        }
+      // The block is the only buffer, stdio's would just add another copy
+      std::setvbuf (m_file, 0, _IONBF, 0);
+    }
+  m_binary = binary;
+  uint32_t minBytes = MAX_LINE;
+  m_block.resize (blockBytes < minBytes ? minBytes : blockBytes);
+  m_used = 0;
+  m_records = 0;
+  m_bytes = 0;
+
+  if (m_binary)
+    {
+      uint8_t *p = &m_block[0];
+      std::memcpy (p, "NS3STATS", 8);
+      p = WriteLe32 (p + 8, 1);
+      WriteLe32 (p, RECORD_SIZE);
+      m_used = HEADER_SIZE;
+    }
+  else
+    {
+      m_used = std::sprintf (reinterpret_cast<char *> (&m_block[0]), "# time flow rxBytes txPackets rxPackets Mbps\n");
+    }
+  return true;
+}
+
+uint8_t *
+StatsStream::WriteLe32 (uint8_t *p, uint32_t v)
+{
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  p[2] = (v >> 16) & 0xff;
+  p[3] = (v >> 24) & 0xff;
+  return p + 4;
+}
+
+uint8_t *
+StatsStream::WriteLe64 (uint8_t *p, uint64_t v)
+{
+  return WriteLe32 (WriteLe32 (p, v & 0xffffffff), v >> 32);
+}
+
+void
+StatsStream::Reserve (uint32_t bytes)
+{
+  if (m_used + bytes > m_block.size ())
+    {
+      Flush ();
+    }
+}
+
+void
+StatsStream::Append (Time time, uint32_t flowId, uint64_t rxBytes, uint32_t txPackets, uint32_t rxPackets, double throughput)
+{
+  if (!IsOpen ())
+    {
+      return;
+    }
+
+  if (m_binary)
+    {
+      Reserve (RECORD_SIZE);
+      float mbps = throughput;
+      uint32_t bits;
+      std::memcpy (&bits, &mbps, sizeof (bits));
+      uint8_t *p = &m_block[m_used];
+      p = WriteLe64 (p, time.GetNanoSeconds ());
+      p = WriteLe32 (p, flowId);
+      p = WriteLe32 (p, txPackets);
+      p = WriteLe64 (p, rxBytes);
+      p = WriteLe32 (p, rxPackets);
+      WriteLe32 (p, bits);
+      m_used += RECORD_SIZE;
+    }
+  else
+    {
+      Reserve (MAX_LINE);
+      char *line = reinterpret_cast<char *> (&m_block[m_used]);
+      int length = snprintf (line, MAX_LINE, "%.9f %u %llu %u %u %.6f\n",
+                             time.GetSeconds (), flowId, static_cast<unsigned long long> (rxBytes),
+                             txPackets, rxPackets, throughput);
+      if (length < 0)
+        {
+          return;
+        }
+      if (static_cast<uint32_t> (length) >= MAX_LINE)
+        {
+          // snprintf returns the untruncated length: keep what fit, still one line
+          length = MAX_LINE - 1;
+          line[length - 1] = '\n';
+        }
+      m_used += length;
+    }
+  m_records++;
+}
+
+void
+StatsStream::Flush (void)
+{
+  if (m_used == 0)
+    {
+      return;
+    }
+  if (m_async.IsOpen ())
+    {
+      // Stats rows are never dropped: wait for the writer thread instead
+      m_bytes += m_async.WriteWait (&m_block[0], m_used) ? m_used : 0;
+    }
+  else if (m_file)
+    {
+      m_bytes += std::fwrite (&m_block[0], 1, m_used, m_file);
+    }
+  m_used = 0;
+}
+
+void
+StatsStream::Close (void)
+{
+  Flush ();
+  if (m_async.IsOpen ())
+    {
+      m_async.Close ();
+    }
+  if (m_file)
+    {
+      std::fclose (m_file);
+      m_file = 0;
+    }
+}
+
+bool
+StatsStream::IsOpen (void) const
+{
+  return m_file != 0 || m_async.IsOpen ();
+}
+
+uint64_t
+StatsStream::GetRecordsWritten (void) const
+{
+  return m_records;
+}
+
+uint64_t
+StatsStream::GetBytesWritten (void) const
+{
+  return m_bytes;
+}
+
+#endif /* STATS_STREAM_H */
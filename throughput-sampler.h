@@ -0,0 +1,234 @@
+#ifndef THROUGHPUT_SAMPLER_H
+#define THROUGHPUT_SAMPLER_H
+
+#include "ns3/core-module.h"
+#include "ns3/flow-monitor-module.h"
+
+#include "stats-stream.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <vector>
+
+using namespace ns3;
+
+/*
+ * ThroughputSampler turns the cumulative FlowMonitor counters into
+ * per-interval deltas.
+ *
+ * The previous rx/tx counters of every flow are kept in arrays indexed by
+ * FlowId, so each call to Sample() emits one row per flow that moved traffic
+ * since the last call, with the instantaneous throughput over that interval.
+ * Rows go into a columnar buffer that is allocated once by the constructor.
+ * Rows past the capacity, and flows with an id above maxFlows, are dropped
+ * and counted. Five-tuples are only looked up in Report().
+ *
+ * FlowMonitor::GetFlowStats () returns its map by value on this ns-3, so
+ * every Sample() still copies the stats of all flows once; FlowMonitor has
+ * no public hook to read only the flows that changed.
+ *
+ * With a StatsStream attached, every row is also appended to it, including
+ * rows that no longer fit in the buffer.
+ */
+class ThroughputSampler
+{
+public:
+
+  ThroughputSampler (Ptr<FlowMonitor> monitor, uint32_t maxFlows, uint32_t maxRows);
+
+  /// Also append every row to stream (0 to detach)
+  void SetStream (StatsStream *stream);
+
+  /// Append one row per flow whose counters changed since the previous call
+  void Sample (void);
+
+  uint32_t GetNRows (void) const;
+  uint32_t GetRowsDropped (void) const;
+  double GetTime (uint32_t row) const;
+  FlowId GetFlowId (uint32_t row) const;
+  uint64_t GetRxBytes (uint32_t row) const;
+  uint32_t GetTxPackets (uint32_t row) const;
+  uint32_t GetRxPackets (uint32_t row) const;
+  /// Throughput over the row's interval, in Mbps
+  double GetThroughput (uint32_t row) const;
+
+  /// Print per-flow mean and peak interval throughput
+  void Report (std::ostream &os, Ptr<Ipv4FlowClassifier> classifier) const;
+
+private:
+  Ptr<FlowMonitor> m_monitor;
+  int64_t          m_lastSample;
+  StatsStream     *m_stream;
+
+  // Counters at the previous sample, indexed by FlowId
+  std::vector<uint64_t> m_prevRxBytes;
+  std::vector<uint32_t> m_prevTxPackets;
+  std::vector<uint32_t> m_prevRxPackets;
+
+  // One entry per row, preallocated to the capacity
+  std::vector<double>   m_time;
+  std::vector<FlowId>   m_flowId;
+  std::vector<uint64_t> m_rxBytes;
+  std::vector<uint32_t> m_txPackets;
+  std::vector<uint32_t> m_rxPackets;
+  std::vector<double>   m_throughput;
+
+  uint32_t m_nRows;
+  uint32_t m_dropped;
+};
+
+ThroughputSampler::ThroughputSampler (Ptr<FlowMonitor> monitor, uint32_t maxFlows, uint32_t maxRows)
+  : m_monitor (monitor),
+    m_lastSample (0),
+    m_stream (0),
+    m_prevRxBytes (maxFlows + 1, 0),
+    m_prevTxPackets (maxFlows + 1, 0),
+    m_prevRxPackets (maxFlows + 1, 0),
+    m_time (maxRows),
+    m_flowId (maxRows),
+    m_rxBytes (maxRows),
+    m_txPackets (maxRows),
+    m_rxPackets (maxRows),
+    m_throughput (maxRows),
+    m_nRows (0),
+    m_dropped (0)
+{
+}
+
+void
+ThroughputSampler::SetStream (StatsStream *stream)
+{
+  m_stream = stream;
+}
+
+void
+ThroughputSampler::Sample (void)
+{
+  int64_t now = Simulator::Now ().GetTimeStep ();
+  double interval = TimeStep (now - m_lastSample).GetSeconds ();
+  m_lastSample = now;
+
+  std::map<FlowId, FlowMonitor::FlowStats> flowStats = m_monitor->GetFlowStats ();
+  for (std::map<FlowId, FlowMonitor::FlowStats>::const_iterator stats = flowStats.begin (); stats != flowStats.end (); ++stats)
+    {
+      FlowId id = stats->first;
+      if (id >= m_prevRxBytes.size ())
+        {
+          m_dropped++;
+          continue;
+        }
+      uint64_t rxBytes = stats->second.rxBytes - m_prevRxBytes[id];
+      uint32_t txPackets = stats->second.txPackets - m_prevTxPackets[id];
+      uint32_t rxPackets = stats->second.rxPackets - m_prevRxPackets[id];
+      if (rxBytes == 0 && txPackets == 0 && rxPackets == 0)
+        {
+          continue;
+        }
+      m_prevRxBytes[id] = stats->second.rxBytes;
+      m_prevTxPackets[id] = stats->second.txPackets;
+      m_prevRxPackets[id] = stats->second.rxPackets;
+
+      double throughput = interval > 0 ? rxBytes * 8.0 / interval / 1024 / 1024 : 0;
+      if (m_stream)
+        {
+          m_stream->Append (TimeStep (now), id, rxBytes, txPackets, rxPackets, throughput);
+        }
+      if (m_nRows == m_time.size ())
+        {
+          m_dropped++;
+          continue;
+        }
+      m_time[m_nRows] = TimeStep (now).GetSeconds ();
+      m_flowId[m_nRows] = id;
+      m_rxBytes[m_nRows] = rxBytes;
+      m_txPackets[m_nRows] = txPackets;
+      m_rxPackets[m_nRows] = rxPackets;
+      m_throughput[m_nRows] = throughput;
+      m_nRows++;
+    }
+}
+
+uint32_t
+ThroughputSampler::GetNRows (void) const
+{
+  return m_nRows;
+}
+
+uint32_t
+ThroughputSampler::GetRowsDropped (void) const
+{
+  return m_dropped;
+}
+
+double
+ThroughputSampler::GetTime (uint32_t row) const
+{
+  return m_time[row];
+}
+
+FlowId
+ThroughputSampler::GetFlowId (uint32_t row) const
+{
+  return m_flowId[row];
+}
+
+uint64_t
+ThroughputSampler::GetRxBytes (uint32_t row) const
+{
+  return m_rxBytes[row];
+}
+
+uint32_t
+ThroughputSampler::GetTxPackets (uint32_t row) const
+{
+  return m_txPackets[row];
+}
+
+uint32_t
+ThroughputSampler::GetRxPackets (uint32_t row) const
+{
+  return m_rxPackets[row];
+}
+
+double
+ThroughputSampler::GetThroughput (uint32_t row) const
+{
+  return m_throughput[row];
+}
+
+void
+ThroughputSampler::Report (std::ostream &os, Ptr<Ipv4FlowClassifier> classifier) const
+{
+  std::vector<uint32_t> samples (m_prevRxBytes.size (), 0);
+  std::vector<double> sum (m_prevRxBytes.size (), 0);
+  std::vector<double> peak (m_prevRxBytes.size (), 0);
+  for (uint32_t row = 0; row < m_nRows; ++row)
+    {
+      FlowId id = m_flowId[row];
+      samples[id]++;
+      sum[id] += m_throughput[row];
+      peak[id] = std::max (peak[id], m_throughput[row]);
+    }
+
+  for (FlowId id = 0; id < samples.size (); ++id)
+    {
+      if (samples[id] == 0)
+        {
+          continue;
+        }
+      Ipv4FlowClassifier::FiveTuple fiveTuple = classifier->FindFlow (id);
+      os << "Flow ID     : " << id << " ; " << fiveTuple.sourceAddress << " -----> " << fiveTuple.destinationAddress << std::endl;
+      os << "Tx Packets = " << m_prevTxPackets[id] << std::endl;
+      os << "Rx Packets = " << m_prevRxPackets[id] << std::endl;
+      os << "Mean throughput: " << sum[id] / samples[id] << " Mbps over " << samples[id] << " active intervals" << std::endl;
+      os << "Peak throughput: " << peak[id] << " Mbps" << std::endl;
+      os << "---------------------------------------------------------------------------" << std::endl;
+    }
+  if (m_dropped > 0)
+    {
+      os << "Throughput rows dropped: " << m_dropped << std::endl;
+    }
+}
+
+#endif /* THROUGHPUT_SAMPLER_H */
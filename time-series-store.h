@@ -0,0 +1,281 @@
+#ifndef TIME_SERIES_STORE_H
+#define TIME_SERIES_STORE_H
+
+#include "ns3/core-module.h"
+#include "ns3/gnuplot.h"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+/*
+ * TimeSeriesStore keeps downsampled time series, one per series id (a FlowId
+ * in the mesh scenarios), for plotting once the run is over.
+ *
+ * Samples are folded into fixed-width time buckets that keep min, max, mean
+ * and count. Each series holds at most `capacity` finished buckets in a ring,
+ * so memory is bounded whatever the run length: once a ring is full the
+ * oldest bucket is dropped and counted. The store is meant to be owned by the
+ * scenario and handed around by pointer.
+ *
+ * Binary output layout, all little-endian:
+ *
+ *   header (16 bytes):  char magic[8] = "NS3TSTOR", uint32 version = 1, uint32 record size = 40
+ *   record (40 bytes):  uint32 series, uint32 count, double start (s),
+ *                       double min, double max, double mean
+ */
+class TimeSeriesStore
+{
+public:
+
+  TimeSeriesStore (uint32_t capacity, Time bucketWidth);
+
+  void Add (uint32_t series, double time, double value);
+
+  uint32_t GetNSeries (void) const;
+  uint64_t GetBucketsDropped (void) const;
+
+  /// Add one dataset per series, plotting the bucket means
+  void AddToPlot (Gnuplot &plot, std::string titlePrefix) const;
+  void WriteCsv (std::ostream &os) const;
+  bool WriteBinary (std::string fileName) const;
+
+  static const uint32_t HEADER_SIZE = 16;
+  static const uint32_t RECORD_SIZE = 40;
+
+private:
+  struct Bucket
+  {
+    double   start;
+    double   min;
+    double   max;
+    double   sum;
+    uint32_t count;
+  };
+
+  struct Series
+  {
+    Series () : head (0), size (0), used (false) { current.count = 0; }
+    std::vector<Bucket> ring;
+    uint32_t head;
+    uint32_t size;
+    Bucket   current;
+    bool     used;
+  };
+
+  void Close (Series &series);
+  /// Finished buckets of series in time order, followed by the open one
+  void Collect (const Series &series, std::vector<Bucket> &buckets) const;
+  static uint8_t *WriteLe32 (uint8_t *p, uint32_t v);
+  static uint8_t *WriteLe64 (uint8_t *p, uint64_t v);
+  static uint8_t *WriteDouble (uint8_t *p, double v);
+
+  uint32_t            m_capacity;
+  double              m_width;
+  std::vector<Series> m_series;
+  uint32_t            m_nSeries;
+  uint64_t            m_dropped;
+};
+
+TimeSeriesStore::TimeSeriesStore (uint32_t capacity, Time bucketWidth)
+  : m_capacity (capacity > 0 ? capacity : 1),
+    m_width (bucketWidth.GetSeconds ()),
+    m_nSeries (0),
+    m_dropped (0)
+{
+}
+
+void
+TimeSeriesStore::Add (uint32_t series, double time, double value)
+{
+  if (series >= m_series.size ())
+    {
+      m_series.resize (series + 1);
+    }
+  Series &s = m_series[series];
+  if (!s.used)
+    {
+      s.used = true;
+      s.ring.resize (m_capacity);
+      m_nSeries++;
+    }
+
+  Bucket &b = s.current;
+  if (b.count > 0 && time >= b.start + m_width)
+    {
+      Close (s);
+    }
+  if (b.count == 0)
+    {
+      b.start = m_width > 0 ? static_cast<int64_t> (time / m_width) * m_width : time;
+      b.min = value;
+      b.max = value;
+      b.sum = 0;
+    }
+  b.min = std::min (b.min, value);
+  b.max = std::max (b.max, value);
+  b.sum += value;
+  b.count++;
+}
+
+void
+TimeSeriesStore::Close (Series &series)
+{
+  if (series.size == m_capacity)
+    {
+      // Ring full, the oldest bucket goes
+      series.head = (series.head + 1) % m_capacity;
+      series.size--;
+      m_dropped++;
+    }
+  series.ring[(series.head + series.size) % m_capacity] = series.current;
+  series.size++;
+  series.current.count = 0;
+}
+
+void
+TimeSeriesStore::Collect (const Series &series, std::vector<Bucket> &buckets) const
+{
+  buckets.clear ();
+  for (uint32_t i = 0; i < series.size; ++i)
+    {
+      buckets.push_back (series.ring[(series.head + i) % m_capacity]);
+    }
+  if (series.current.count > 0)
+    {
+      buckets.push_back (series.current);
+    }
+}
+
+uint32_t
+TimeSeriesStore::GetNSeries (void) const
+{
+  return m_nSeries;
+}
+
+uint64_t
+TimeSeriesStore::GetBucketsDropped (void) const
+{
+  return m_dropped;
+}
+
+void
+TimeSeriesStore::AddToPlot (Gnuplot &plot, std::string titlePrefix) const
+{
+  std::vector<Bucket> buckets;
+  for (uint32_t id = 0; id < m_series.size (); ++id)
+    {
+      if (!m_series[id].used)
+        {
+          continue;
+        }
+      std::ostringstream title;
+      title << titlePrefix << id;
+      Gnuplot2dDataset dataset;
+      dataset.SetTitle (title.str ());
+      dataset.SetStyle (Gnuplot2dDataset::LINES_POINTS);
+
+      Collect (m_series[id], buckets);
+      for (uint32_t i = 0; i < buckets.size (); ++i)
+        {
+          dataset.Add (buckets[i].start, buckets[i].sum / buckets[i].count);
+        }
+      plot.AddDataset (dataset);
+    }
+}
+
+void
+TimeSeriesStore::WriteCsv (std::ostream &os) const
+{
+  std::vector<Bucket> buckets;
+  os << "series,start,count,min,max,mean\n";
+  for (uint32_t id = 0; id < m_series.size (); ++id)
+    {
+      if (!m_series[id].used)
+        {
+          continue;
+        }
+      Collect (m_series[id], buckets);
+      for (uint32_t i = 0; i < buckets.size (); ++i)
+        {
+          const Bucket &b = buckets[i];
+          os << id << "," << b.start << "," << b.count << "," << b.min << "," << b.max << "," << b.sum / b.count << "\n";
+        }
+    }
+}
+
+uint8_t *
+TimeSeriesStore::WriteLe32 (uint8_t *p, uint32_t v)
+{
+  p[0] = v & 0xff;
+  p[1] = (v >> 8) & 0xff;
+  p[2] = (v >> 16) & 0xff;
+  p[3] = (v >> 24) & 0xff;
+  return p + 4;
+}
+
+uint8_t *
+TimeSeriesStore::WriteLe64 (uint8_t *p, uint64_t v)
+{
+  return WriteLe32 (WriteLe32 (p, v & 0xffffffff), v >> 32);
+}
+
+uint8_t *
+TimeSeriesStore::WriteDouble (uint8_t *p, double v)
+{
+  uint64_t bits;
+  std::memcpy (&bits, &v, sizeof (bits));
+  return WriteLe64 (p, bits);
+}
+
+bool
+TimeSeriesStore::WriteBinary (std::string fileName) const
+{
+  std::ofstream out (fileName.c_str (), std::ios::out | std::ios::binary);
+  if (!out)
+    {
+      std::cerr << "Error: Can't open " << fileName << "\n";
+      return false;
+    }
+
+  uint8_t header[HEADER_SIZE];
+  std::memcpy (header, "NS3TSTOR", 8);
+  WriteLe32 (WriteLe32 (header + 8, 1), RECORD_SIZE);
+  out.write (reinterpret_cast<const char *> (header), HEADER_SIZE);
+
+  std::vector<Bucket> buckets;
+  std::vector<uint8_t> block;
+  for (uint32_t id = 0; id < m_series.size (); ++id)
+    {
+      if (!m_series[id].used)
+        {
+          continue;
+        }
+      Collect (m_series[id], buckets);
+      block.resize (buckets.size () * RECORD_SIZE);
+      uint8_t *p = block.empty () ? 0 : &block[0];
+      for (uint32_t i = 0; i < buckets.size (); ++i)
+        {
+          const Bucket &b = buckets[i];
+          p = WriteLe32 (p, id);
+          p = WriteLe32 (p, b.count);
+          p = WriteDouble (p, b.start);
+          p = WriteDouble (p, b.min);
+          p = WriteDouble (p, b.max);
+          p = WriteDouble (p, b.sum / b.count);
+        }
+      if (!block.empty ())
+        {
+          out.write (reinterpret_cast<const char *> (&block[0]), block.size ());
+        }
+    }
+  return out.good ();
+}
+
+#endif /* TIME_SERIES_STORE_H */
@@ -0,0 +1,337 @@
+#ifndef TRACE_REPLAY_H
+#define TRACE_REPLAY_H
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include <cstring>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+/*
+ * TraceReplayApp replays a binary packet trace instead of generating
+ * synthetic constant-rate traffic like MyApp.
+ *
+ * File layout, all integers little-endian:
+ *
+ *   header (16 bytes):  char magic[8] = "NS3TRACE", uint32 version = 1, uint32 reserved
+ *   record (16 bytes):  uint64 timestamp (ns, relative to application start),
+ *                       uint32 packet size (bytes), uint32 flow id
+ *
+ * Records must be sorted by timestamp. The file is never read into memory as
+ * a whole: a window of it is mmap'ed at a time and the kernel is asked to
+ * read the following window ahead while the current one is being replayed.
+ * Records whose flow id has no socket attached are skipped and counted.
+ */
+class TraceReplayApp : public Application
+{
+public:
+
+  TraceReplayApp ();
+  virtual ~TraceReplayApp();
+
+  void Setup (std::string traceFile, uint64_t windowBytes = 64 * 1024 * 1024);
+  /// Send the records of flowId through socket, connected to address
+  void AddFlow (uint32_t flowId, Ptr<Socket> socket, Address address);
+  uint64_t GetRecordsReplayed (void) const;
+  uint64_t GetRecordsSkipped (void) const;
+
+  static const uint32_t HEADER_SIZE = 16;
+  static const uint32_t RECORD_SIZE = 16;
+
+private:
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+
+  bool OpenTrace (void);
+  void CloseTrace (void);
+  bool MapWindow (uint64_t offset);
+  bool ReadRecord (uint64_t &timestamp, uint32_t &size, uint32_t &flowId);
+  void ScheduleNext (void);
+  void SendRecords (void);
+
+  static uint32_t ReadLe32 (const uint8_t *p);
+  static uint64_t ReadLe64 (const uint8_t *p);
+
+  std::string     m_traceFile;
+  uint64_t        m_windowBytes;
+  int             m_fd;
+  uint64_t        m_fileSize;
+  uint8_t        *m_window;
+  uint64_t        m_windowOffset;
+  uint64_t        m_windowLength;
+  uint64_t        m_cursor;
+  uint64_t        m_nextTimestamp;
+  bool            m_havePending;
+  Time            m_startTime;
+  EventId         m_sendEvent;
+  bool            m_running;
+  uint64_t        m_replayed;
+  uint64_t        m_skipped;
+
+  std::map<uint32_t, uint32_t> m_flowIndex;
+  std::vector<Ptr<Socket> >    m_sockets;
+  std::vector<Address>         m_peers;
+};
+
+TraceReplayApp::TraceReplayApp ()
+  : m_traceFile (),
+    m_windowBytes (0),
+    m_fd (-1),
+    m_fileSize (0),
+    m_window (0),
+    m_windowOffset (0),
+    m_windowLength (0),
+    m_cursor (0),
+    m_nextTimestamp (0),
+    m_havePending (false),
+    m_startTime (),
+    m_sendEvent (),
+    m_running (false),
+    m_replayed (0),
+    m_skipped (0)
+{
+}
+
+TraceReplayApp::~TraceReplayApp()
+{
+  CloseTrace ();
+  m_sockets.clear ();
+}
+
+void
+TraceReplayApp::Setup (std::string traceFile, uint64_t windowBytes)
+{
+  m_traceFile = traceFile;
+  m_windowBytes = windowBytes;
+}
+
+void
+TraceReplayApp::AddFlow (uint32_t flowId, Ptr<Socket> socket, Address address)
+{
+  m_flowIndex[flowId] = m_sockets.size ();
+  m_sockets.push_back (socket);
+  m_peers.push_back (address);
+}
+
+uint64_t
+TraceReplayApp::GetRecordsReplayed (void) const
+{
+  return m_replayed;
+}
+
+uint64_t
+TraceReplayApp::GetRecordsSkipped (void) const
+{
+  return m_skipped;
+}
+
+uint32_t
+TraceReplayApp::ReadLe32 (const uint8_t *p)
+{
+  return static_cast<uint32_t> (p[0])
+         | (static_cast<uint32_t> (p[1]) << 8)
+         | (static_cast<uint32_t> (p[2]) << 16)
+         | (static_cast<uint32_t> (p[3]) << 24);
+}
+
+uint64_t
+TraceReplayApp::ReadLe64 (const uint8_t *p)
+{
+  return static_cast<uint64_t> (ReadLe32 (p)) | (static_cast<uint64_t> (ReadLe32 (p + 4)) << 32);
+}
+
+bool
+TraceReplayApp::OpenTrace (void)
+{
+  m_fd = open (m_traceFile.c_str (), O_RDONLY);
+  if (m_fd < 0)
+    {
+      std::cerr << "Error: Can't open trace " << m_traceFile << "\n";
+      return false;
+    }
+
+  struct stat st;
+  uint8_t header[HEADER_SIZE];
+  if (fstat (m_fd, &st) != 0 || pread (m_fd, header, HEADER_SIZE, 0) != HEADER_SIZE
+      || std::memcmp (header, "NS3TRACE", 8) != 0 || ReadLe32 (header + 8) != 1)
+    {
+      std::cerr << "Error: " << m_traceFile << " is not a version 1 packet trace\n";
+      CloseTrace ();
+      return false;
+    }
+  m_fileSize = st.st_size;
+  m_cursor = HEADER_SIZE;
+
+  // Windows are replayed front to back exactly once
+  posix_fadvise (m_fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+  return MapWindow (m_cursor);
+}
+
+void
+TraceReplayApp::CloseTrace (void)
+{
+  if (m_window)
+    {
+      munmap (m_window, m_windowLength);
+      m_window = 0;
+    }
+  if (m_fd >= 0)
+    {
+      close (m_fd);
+      m_fd = -1;
+    }
+}
+
+bool
+TraceReplayApp::MapWindow (uint64_t offset)
+{
+  if (m_window)
+    {
+      munmap (m_window, m_windowLength);
+      m_window = 0;
+    }
+
+  uint64_t pageSize = sysconf (_SC_PAGESIZE);
+  uint64_t windowBytes = m_windowBytes < pageSize ? pageSize : m_windowBytes - m_windowBytes % pageSize;
+  m_windowOffset = offset - offset % pageSize;
+  m_windowLength = m_fileSize - m_windowOffset;
+  if (m_windowLength > windowBytes)
+    {
+      m_windowLength = windowBytes;
+    }
+  if (m_windowLength == 0)
+    {
+      return false;
+    }
+
+  void *window = mmap (0, m_windowLength, PROT_READ, MAP_PRIVATE, m_fd, m_windowOffset);
+  if (window == MAP_FAILED)
+    {
+      std::cerr << "Error: Can't map " << m_traceFile << " at offset " << m_windowOffset << "\n";
+      return false;
+    }
+  m_window = static_cast<uint8_t *> (window);
+
+  // Prefetch the next window while this one is replayed
+  uint64_t next = m_windowOffset + m_windowLength;
+  if (next < m_fileSize)
+    {
+      posix_fadvise (m_fd, next, windowBytes, POSIX_FADV_WILLNEED);
+    }
+  return true;
+}
+
+bool
+TraceReplayApp::ReadRecord (uint64_t &timestamp, uint32_t &size, uint32_t &flowId)
+{
+  if (m_cursor + RECORD_SIZE > m_fileSize)
+    {
+      return false;
+    }
+  if (m_cursor + RECORD_SIZE > m_windowOffset + m_windowLength && !MapWindow (m_cursor))
+    {
+      return false;
+    }
+
+  const uint8_t *record = m_window + (m_cursor - m_windowOffset);
+  timestamp = ReadLe64 (record);
+  size = ReadLe32 (record + 8);
+  flowId = ReadLe32 (record + 12);
+  m_cursor += RECORD_SIZE;
+  return true;
+}
+
+void
+TraceReplayApp::StartApplication (void)
+{
+  m_running = true;
+  m_replayed = 0;
+  m_skipped = 0;
+  m_startTime = Simulator::Now ();
+
+  for (uint32_t i = 0; i < m_sockets.size (); ++i)
+    {
+      m_sockets[i]->Bind ();
+      m_sockets[i]->Connect (m_peers[i]);
+    }
+
+  if (OpenTrace ())
+    {
+      ScheduleNext ();
+    }
+}
+
+void
+TraceReplayApp::StopApplication (void)
+{
+  m_running = false;
+
+  if (m_sendEvent.IsRunning ())
+    {
+      Simulator::Cancel (m_sendEvent);
+    }
+
+  for (uint32_t i = 0; i < m_sockets.size (); ++i)
+    {
+      m_sockets[i]->Close ();
+    }
+  CloseTrace ();
+}
+
+void
+TraceReplayApp::ScheduleNext (void)
+{
+  uint32_t size;
+  uint32_t flowId;
+  if (!m_running || !ReadRecord (m_nextTimestamp, size, flowId))
+    {
+      m_havePending = false;
+      return;
+    }
+  // Step back so SendRecords re-reads the record it was scheduled for
+  m_cursor -= RECORD_SIZE;
+  m_havePending = true;
+
+  Time at = m_startTime + NanoSeconds (m_nextTimestamp);
+  Time delay = at > Simulator::Now () ? at - Simulator::Now () : Time ();
+  m_sendEvent = Simulator::Schedule (delay, &TraceReplayApp::SendRecords, this);
+}
+
+void
+TraceReplayApp::SendRecords (void)
+{
+  // Every record sharing the scheduled timestamp goes out in one event
+  uint64_t timestamp;
+  uint32_t size;
+  uint32_t flowId;
+  while (m_havePending && ReadRecord (timestamp, size, flowId))
+    {
+      if (timestamp > m_nextTimestamp)
+        {
+          m_cursor -= RECORD_SIZE;
+          break;
+        }
+
+      std::map<uint32_t, uint32_t>::const_iterator it = m_flowIndex.find (flowId);
+      if (it == m_flowIndex.end ())
+        {
+          m_skipped++;
+          continue;
+        }
+      m_sockets[it->second]->Send (Create<Packet> (size));
+      m_replayed++;
+    }
+  ScheduleNext ();
+}
+
+#endif /* TRACE_REPLAY_H */
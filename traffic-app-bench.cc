@@ -0,0 +1,200 @@
+/* -*- Mode:C++; c-file-style:"gnu"; indent-tabs-mode:nil; -*- */
+/*
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2 as
+ * published by the Free Software Foundation;
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program; if not, write to the Free Software
+ * Foundation, Inc., 59 Temple Place, Suite 330, Boston, MA  02111-1307  USA
+ */
+
+/*
+ * Micro-benchmark of the traffic generators.
+ *
+ * Runs the same UDP workload (nFlows flows of nPackets packets over one fast
+ * P2P link) twice: once with LegacyApp, the MyApp class the scenarios used
+ * before TrafficApp, and once with the current MyApp
+ * (TrafficApp<ConstantRatePacing, FixedSize>). Wall time of each run and the
+ * packets received by the sink are printed, so the two can be compared.
+ */
+
+#include "ns3/core-module.h"
+#include "ns3/network-module.h"
+#include "ns3/point-to-point-module.h"
+#include "ns3/applications-module.h"
+#include "ns3/internet-module.h"
+#include "myapp.h"
+
+using namespace ns3;
+
+NS_LOG_COMPONENT_DEFINE ("TrafficAppBench");
+
+class LegacyApp : public Application
+{
+public:
+
+  LegacyApp ();
+  virtual ~LegacyApp();
+
+  void Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, DataRate dataRate);
+
+private:
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+
+  void ScheduleTx (void);
+  void SendPacket (void);
+
+  Ptr<Socket>     m_socket;
+  Address         m_peer;
+  uint32_t        m_packetSize;
+  uint32_t        m_nPackets;
+  DataRate        m_dataRate;
+  EventId         m_sendEvent;
+  bool            m_running;
+  uint32_t        m_packetsSent;
+};
+
+LegacyApp::LegacyApp ()
+  : m_socket (0),
+    m_peer (),
+    m_packetSize (0),
+    m_nPackets (0),
+    m_dataRate (0),
+    m_sendEvent (),
+    m_running (false),
+    m_packetsSent (0)
+{
+}
+
+LegacyApp::~LegacyApp()
+{
+  m_socket = 0;
+}
+
+void
+LegacyApp::Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, DataRate dataRate)
+{
+  m_socket = socket;
+  m_peer = address;
+  m_packetSize = packetSize;
+  m_nPackets = nPackets;
+  m_dataRate = dataRate;
+}
+
+void
+LegacyApp::StartApplication (void)
+{
+  m_running = true;
+  m_packetsSent = 0;
+  m_socket->Bind ();
+  m_socket->Connect (m_peer);
+  SendPacket ();
+}
+
+void
+LegacyApp::StopApplication (void)
+{
+  m_running = false;
+
+  if (m_sendEvent.IsRunning ())
+    {
+      Simulator::Cancel (m_sendEvent);
+    }
+
+  if (m_socket)
+    {
+      m_socket->Close ();
+    }
+}
+
+void
+LegacyApp::SendPacket (void)
+{
+  Ptr<Packet> packet = Create<Packet> (m_packetSize);
+  m_socket->Send (packet);
+
+  if (++m_packetsSent < m_nPackets)
+    {
+      ScheduleTx ();
+    }
+}
+
+void
+LegacyApp::ScheduleTx (void)
+{
+  if (m_running)
+    {
+      Time tNext (Seconds (m_packetSize * 8 / static_cast<double> (m_dataRate.GetBitRate ())));
+      m_sendEvent = Simulator::Schedule (tNext, &LegacyApp::SendPacket, this);
+    }
+}
+
+template <class App>
+void
+RunOnce (std::string name, uint32_t nFlows, uint32_t nPackets, uint32_t packetSize, std::string rate)
+{
+  NodeContainer nodes;
+  nodes.Create (2);
+
+  PointToPointHelper p2p;
+  p2p.SetDeviceAttribute ("DataRate", StringValue ("10Gbps"));
+  p2p.SetChannelAttribute ("Delay", StringValue ("1ms"));
+  NetDeviceContainer devices = p2p.Install (nodes);
+
+  InternetStackHelper internet;
+  internet.Install (nodes);
+  Ipv4AddressHelper ipv4;
+  ipv4.SetBase ("10.1.1.0", "255.255.255.0");
+  Ipv4InterfaceContainer interfaces = ipv4.Assign (devices);
+
+  uint16_t sinkPort = 9;
+  PacketSinkHelper packetSinkHelper ("ns3::UdpSocketFactory", InetSocketAddress (Ipv4Address::GetAny (), sinkPort));
+  ApplicationContainer sinkApps = packetSinkHelper.Install (nodes.Get (1));
+  sinkApps.Start (Seconds (0.));
+
+  Address sinkAddress (InetSocketAddress (interfaces.GetAddress (1), sinkPort));
+  for (uint32_t i = 0; i < nFlows; ++i)
+    {
+      Ptr<Socket> socket = Socket::CreateSocket (nodes.Get (0), UdpSocketFactory::GetTypeId ());
+      Ptr<App> app = CreateObject<App> ();
+      app->Setup (socket, sinkAddress, packetSize, nPackets, DataRate (rate));
+      nodes.Get (0)->AddApplication (app);
+      app->SetStartTime (Seconds (1.));
+    }
+
+  SystemWallClockMs clock;
+  clock.Start ();
+  Simulator::Run ();
+  int64_t elapsed = clock.End ();
+
+  Ptr<PacketSink> sink = DynamicCast<PacketSink> (sinkApps.Get (0));
+  std::cout << name << "\t" << elapsed << " ms\t" << sink->GetTotalRx () / packetSize << " packets received\n";
+  Simulator::Destroy ();
+}
+
+int
+main (int argc, char *argv[])
+{
+  uint32_t nFlows = 10;
+  uint32_t nPackets = 100000;
+  uint32_t packetSize = 1040;
+  std::string rate = "100Mbps";
+
+  CommandLine cmd;
+  cmd.AddValue ("flows", "Number of concurrent flows", nFlows);
+  cmd.AddValue ("packets", "Packets sent by each flow", nPackets);
+  cmd.AddValue ("packet-size", "Payload size in bytes", packetSize);
+  cmd.AddValue ("rate", "Sending rate of each flow", rate);
+  cmd.Parse (argc, argv);
+
+  RunOnce<LegacyApp> ("legacy", nFlows, nPackets, packetSize, rate);
+  RunOnce<MyApp> ("traffic-app", nFlows, nPackets, packetSize, rate);
+  return 0;
+}
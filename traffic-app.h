@@ -0,0 +1,538 @@
+#ifndef TRAFFIC_APP_H
+#define TRAFFIC_APP_H
+
+#include "ns3/applications-module.h"
+#include "ns3/core-module.h"
+#include "latency-probe.h"
+
+#include <vector>
+
+using namespace ns3;
+
+/*
+ * TrafficApp is the one traffic generator behind MyApp in every scenario.
+ *
+ * How packets are spaced and how big they are is chosen at compile time
+ * through two policy classes, so SendPacket and ScheduleTx call the policies
+ * directly with no virtual dispatch:
+ *
+ *   PacingPolicy:  void SetRate (DataRate rate);
+ *                  Time Gap (uint32_t bytes);      // delay after sending bytes
+ *                  int64_t AssignStreams (int64_t stream);
+ *
+ *   SizePolicy:    static const bool FIXED;        // every packet has the same size
+ *                  void SetSize (uint32_t size);
+ *                  uint32_t Next (void);
+ *                  int64_t AssignStreams (int64_t stream);
+ */
+
+/// Constant bit rate, gap computed in integer nanoseconds and cached per size
+class ConstantRatePacing
+{
+public:
+  ConstantRatePacing ()
+    : m_bitRate (0),
+      m_lastBytes (0),
+      m_lastGap ()
+  {
+  }
+
+  void SetRate (DataRate rate)
+  {
+    m_bitRate = rate.GetBitRate ();
+    m_lastBytes = 0;
+  }
+
+  Time Gap (uint32_t bytes)
+  {
+    if (bytes != m_lastBytes)
+      {
+        m_lastBytes = bytes;
+        m_lastGap = m_bitRate > 0 ? NanoSeconds (static_cast<uint64_t> (bytes) * 8 * 1000000000 / m_bitRate) : Time ();
+      }
+    return m_lastGap;
+  }
+
+  int64_t AssignStreams (int64_t stream)
+  {
+    return 0;
+  }
+
+private:
+  uint64_t m_bitRate;
+  uint32_t m_lastBytes;
+  Time     m_lastGap;
+};
+
+/// Exponentially distributed gaps whose mean matches the configured rate
+class PoissonPacing
+{
+public:
+  PoissonPacing ()
+    : m_rate (),
+      m_exponential (CreateObject<ExponentialRandomVariable> ())
+  {
+  }
+
+  void SetRate (DataRate rate)
+  {
+    m_rate.SetRate (rate);
+  }
+
+  Time Gap (uint32_t bytes)
+  {
+    double mean = m_rate.Gap (bytes).GetSeconds ();
+    return Seconds (m_exponential->GetValue (mean, 0));
+  }
+
+  int64_t AssignStreams (int64_t stream)
+  {
+    m_exponential->SetStream (stream);
+    return 1;
+  }
+
+private:
+  ConstantRatePacing             m_rate;
+  Ptr<ExponentialRandomVariable> m_exponential;
+};
+
+/// Constant rate during ON periods, silent during OFF periods
+class OnOffPacing
+{
+public:
+  OnOffPacing ()
+    : m_rate (),
+      m_onTime (Seconds (1.0)),
+      m_offTime (Seconds (1.0)),
+      m_onLeft (Seconds (1.0))
+  {
+  }
+
+  void SetRate (DataRate rate)
+  {
+    m_rate.SetRate (rate);
+  }
+
+  void SetOnOff (Time onTime, Time offTime)
+  {
+    m_onTime = onTime;
+    m_offTime = offTime;
+    m_onLeft = onTime;
+  }
+
+  Time Gap (uint32_t bytes)
+  {
+    Time gap = m_rate.Gap (bytes);
+    if (m_onLeft >= gap)
+      {
+        m_onLeft = m_onLeft - gap;
+        return gap;
+      }
+    // The next packet falls past the end of the ON period: sit out the OFF
+    // period and carry the remainder into the next ON period.
+    Time over = gap - m_onLeft;
+    m_onLeft = m_onTime > over ? m_onTime - over : Time ();
+    return gap + m_offTime;
+  }
+
+  int64_t AssignStreams (int64_t stream)
+  {
+    return 0;
+  }
+
+private:
+  ConstantRatePacing m_rate;
+  Time               m_onTime;
+  Time               m_offTime;
+  Time               m_onLeft;
+};
+
+/// Every packet has the size given to Setup
+class FixedSize
+{
+public:
+  static const bool FIXED = true;
+
+  FixedSize ()
+    : m_size (0)
+  {
+  }
+
+  void SetSize (uint32_t size)
+  {
+    m_size = size;
+  }
+
+  uint32_t Next (void)
+  {
+    return m_size;
+  }
+
+  int64_t AssignStreams (int64_t stream)
+  {
+    return 0;
+  }
+
+private:
+  uint32_t m_size;
+};
+
+/// Sizes drawn from a distribution; uniform on [1, 2 * size - 1] unless one is set
+class RandomSize
+{
+public:
+  static const bool FIXED = false;
+
+  RandomSize ()
+    : m_distribution (0)
+  {
+  }
+
+  void SetDistribution (Ptr<RandomVariableStream> distribution)
+  {
+    m_distribution = distribution;
+  }
+
+  void SetSize (uint32_t size)
+  {
+    if (!m_distribution)
+      {
+        Ptr<UniformRandomVariable> uniform = CreateObject<UniformRandomVariable> ();
+        uniform->SetAttribute ("Min", DoubleValue (1));
+        uniform->SetAttribute ("Max", DoubleValue (2.0 * size - 1));
+        m_distribution = uniform;
+      }
+  }
+
+  uint32_t Next (void)
+  {
+    uint32_t size = m_distribution->GetInteger ();
+    return size > 0 ? size : 1;
+  }
+
+  int64_t AssignStreams (int64_t stream)
+  {
+    m_distribution->SetStream (stream);
+    return 1;
+  }
+
+private:
+  Ptr<RandomVariableStream> m_distribution;
+};
+
+/// What the scenarios need of any TrafficApp, whatever its policies
+class TrafficAppBase : public Application
+{
+public:
+  /// Fix the random streams used by the policies, returns the number used
+  virtual int64_t AssignStreams (int64_t stream) = 0;
+};
+
+template <class PacingPolicy, class SizePolicy>
+class TrafficApp : public TrafficAppBase
+{
+public:
+
+  TrafficApp ();
+  virtual ~TrafficApp();
+
+  void Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, DataRate dataRate);
+  void ChangeRate (DataRate newrate);
+  /// Send burstSize packets per transmit event (1 keeps exact per-packet pacing)
+  void SetBurstSize (uint32_t burstSize);
+  /// Only build and send packets while the socket has send buffer space
+  void SetBackpressure (bool enable);
+  /// Bytes the socket accepted since the application started
+  uint64_t GetBytesAccepted (void) const;
+  /// Bytes the socket accepted in each whole second of the run
+  const std::vector<uint64_t> & GetAcceptedPerSecond (void) const;
+  /// Prefix every packet with a LatencyHeader (flowId, sequence number, send time), over TCP only with FixedSize
+  void SetStamping (bool enable, uint32_t flowId);
+  virtual int64_t AssignStreams (int64_t stream);
+
+  PacingPolicy & GetPacingPolicy (void);
+  SizePolicy & GetSizePolicy (void);
+
+private:
+  virtual void StartApplication (void);
+  virtual void StopApplication (void);
+
+  void ScheduleTx (void);
+  void SendPacket (void);
+  void SendSpaceAvailable (Ptr<Socket> socket, uint32_t available);
+  void SampleAccepted (void);
+  uint32_t PayloadSize (uint32_t size) const;
+
+  Ptr<Socket>     m_socket;
+  Address         m_peer;
+  uint32_t        m_packetSize;
+  uint32_t        m_nPackets;
+  DataRate        m_dataRate;
+  EventId         m_sendEvent;
+  bool            m_running;
+  uint32_t        m_packetsSent;
+  uint32_t        m_burstSize;
+  uint32_t        m_burstBytes;
+  bool            m_backpressure;
+  bool            m_blocked;
+  /// Size of the packet that found the socket full, sent first once it drains
+  uint32_t        m_pendingSize;
+  uint64_t        m_bytesAccepted;
+  uint64_t        m_lastSampleBytes;
+  std::vector<uint64_t> m_acceptedPerSecond;
+  EventId         m_sampleEvent;
+  bool            m_stamping;
+  uint32_t        m_flowId;
+  uint32_t        m_seq;
+  PacingPolicy    m_pacing;
+  SizePolicy      m_size;
+};
+
+template <class PacingPolicy, class SizePolicy>
+TrafficApp<PacingPolicy, SizePolicy>::TrafficApp ()
+  : m_socket (0),
+    m_peer (),
+    m_packetSize (0),
+    m_nPackets (0),
+    m_dataRate (0),
+    m_sendEvent (),
+    m_running (false),
+    m_packetsSent (0),
+    m_burstSize (1),
+    m_burstBytes (0),
+    m_backpressure (false),
+    m_blocked (false),
+    m_pendingSize (0),
+    m_bytesAccepted (0),
+    m_lastSampleBytes (0),
+    m_acceptedPerSecond (),
+    m_sampleEvent (),
+    m_stamping (false),
+    m_flowId (0),
+    m_seq (0),
+    m_pacing (),
+    m_size ()
+{
+}
+
+template <class PacingPolicy, class SizePolicy>
+TrafficApp<PacingPolicy, SizePolicy>::~TrafficApp()
+{
+  m_socket = 0;
+}
+
+template <class PacingPolicy, class SizePolicy>
+void
+TrafficApp<PacingPolicy, SizePolicy>::Setup (Ptr<Socket> socket, Address address, uint32_t packetSize, uint32_t nPackets, DataRate dataRate)
+{
+  m_socket = socket;
+  m_peer = address;
+  m_packetSize = packetSize;
+  m_nPackets = nPackets;
+  m_dataRate = dataRate;
+  m_size.SetSize (packetSize);
+  m_pacing.SetRate (dataRate);
+}
+
+template <class PacingPolicy, class SizePolicy>
+void
+TrafficApp<PacingPolicy, SizePolicy>::ChangeRate (DataRate newrate)
+{
+  m_dataRate = newrate;
+  m_pacing.SetRate (newrate);
+}
+
+template <class PacingPolicy, class SizePolicy>
+void
+TrafficApp<PacingPolicy, SizePolicy>::SetBurstSize (uint32_t burstSize)
+{
+  m_burstSize = burstSize > 0 ? burstSize : 1;
+}
+
+template <class PacingPolicy, class SizePolicy>
+void
+TrafficApp<PacingPolicy, SizePolicy>::SetBackpressure (bool enable)
+{
+  m_backpressure = enable;
+}
+
+template <class PacingPolicy, class SizePolicy>
+uint64_t
+TrafficApp<PacingPolicy, SizePolicy>::GetBytesAccepted (void) const
+{
+  return m_bytesAccepted;
+}
+
+template <class PacingPolicy, class SizePolicy>
+const std::vector<uint64_t> &
+TrafficApp<PacingPolicy, SizePolicy>::GetAcceptedPerSecond (void) const
+{
+  return m_acceptedPerSecond;
+}
+
+template <class PacingPolicy, class SizePolicy>
+void
+TrafficApp<PacingPolicy, SizePolicy>::SetStamping (bool enable, uint32_t flowId)
+{
+  m_stamping = enable;
+  m_flowId = flowId;
+}
+
+template <class PacingPolicy, class SizePolicy>
+uint32_t
+TrafficApp<PacingPolicy, SizePolicy>::PayloadSize (uint32_t size) const
+{
+  if (!m_stamping)
+    {
+      return size;
+    }
+  return size > LatencyHeader::SIZE ? size - LatencyHeader::SIZE : 0;
+}
+
+template <class PacingPolicy, class SizePolicy>
+int64_t
+TrafficApp<PacingPolicy, SizePolicy>::AssignStreams (int64_t stream)
+{
+  int64_t used = m_pacing.AssignStreams (stream);
+  return used + m_size.AssignStreams (stream + used);
+}
+
+template <class PacingPolicy, class SizePolicy>
+PacingPolicy &
+TrafficApp<PacingPolicy, SizePolicy>::GetPacingPolicy (void)
+{
+  return m_pacing;
+}
+
+template <class PacingPolicy, class SizePolicy>
+SizePolicy &
+TrafficApp<PacingPolicy, SizePolicy>::GetSizePolicy (void)
+{
+  return m_size;
+}
+
+template <class PacingPolicy, class SizePolicy>
+void
+TrafficApp<PacingPolicy, SizePolicy>::StartApplication (void)
+{
+  m_running = true;
+  m_packetsSent = 0;
+  m_blocked = false;
+  m_pendingSize = 0;
+  m_bytesAccepted = 0;
+  m_lastSampleBytes = 0;
+  m_acceptedPerSecond.clear ();
+  m_seq = 0;
+  // LatencySink cuts a TCP stream into messages of the one size it was given
+  NS_ABORT_MSG_IF (m_stamping && !SizePolicy::FIXED && DynamicCast<TcpSocket> (m_socket),
+                   "Stamped packets of random size can't be framed in a TCP stream");
+  m_socket->Bind ();
+  m_socket->Connect (m_peer);
+  if (m_backpressure)
+    {
+      m_socket->SetSendCallback (MakeCallback (&TrafficApp::SendSpaceAvailable, this));
+    }
+  m_sampleEvent = Simulator::Schedule (Seconds (1.0), &TrafficApp::SampleAccepted, this);
+  SendPacket ();
+}
+
+template <class PacingPolicy, class SizePolicy>
+void
+TrafficApp<PacingPolicy, SizePolicy>::StopApplication (void)
+{
+  m_running = false;
+
+  if (m_sendEvent.IsRunning ())
+    {
+      Simulator::Cancel (m_sendEvent);
+    }
+  Simulator::Cancel (m_sampleEvent);
+
+  if (m_socket)
+    {
+      m_socket->Close ();
+    }
+}
+
+template <class PacingPolicy, class SizePolicy>
+void
+TrafficApp<PacingPolicy, SizePolicy>::SendPacket (void)
+{
+  uint32_t burst = m_nPackets - m_packetsSent;
+  if (burst == 0 || burst > m_burstSize)
+    {
+      burst = m_burstSize;
+    }
+
+  uint32_t sent = 0;
+  m_burstBytes = 0;
+  for (; sent < burst; ++sent)
+    {
+      uint32_t size = m_pendingSize > 0 ? m_pendingSize : m_size.Next ();
+      m_pendingSize = 0;
+      if (m_backpressure && m_socket->GetTxAvailable () < size)
+        {
+          // The socket would refuse the packet; wait for SendSpaceAvailable
+          // instead of building it, and keep its size for then.
+          m_blocked = true;
+          m_pendingSize = size;
+          break;
+        }
+
+      Ptr<Packet> packet = Create<Packet> (PayloadSize (size));
+      if (m_stamping)
+        {
+          LatencyHeader header;
+          header.Set (m_flowId, m_seq++, Simulator::Now ());
+          packet->AddHeader (header);
+        }
+
+      int accepted = m_socket->Send (packet);
+      if (accepted > 0)
+        {
+          m_bytesAccepted += accepted;
+        }
+      m_burstBytes += size;
+    }
+
+  m_packetsSent += sent;
+  if (!m_blocked && m_packetsSent < m_nPackets)
+    {
+      ScheduleTx ();
+    }
+}
+
+template <class PacingPolicy, class SizePolicy>
+void
+TrafficApp<PacingPolicy, SizePolicy>::ScheduleTx (void)
+{
+  if (m_running)
+    {
+      m_sendEvent = Simulator::Schedule (m_pacing.Gap (m_burstBytes), &TrafficApp::SendPacket, this);
+    }
+}
+
+template <class PacingPolicy, class SizePolicy>
+void
+TrafficApp<PacingPolicy, SizePolicy>::SendSpaceAvailable (Ptr<Socket> socket, uint32_t available)
+{
+  if (m_blocked && m_running && available >= m_pendingSize)
+    {
+      m_blocked = false;
+      SendPacket ();
+    }
+}
+
+template <class PacingPolicy, class SizePolicy>
+void
+TrafficApp<PacingPolicy, SizePolicy>::SampleAccepted (void)
+{
+  m_acceptedPerSecond.push_back (m_bytesAccepted - m_lastSampleBytes);
+  m_lastSampleBytes = m_bytesAccepted;
+  if (m_running)
+    {
+      m_sampleEvent = Simulator::Schedule (Seconds (1.0), &TrafficApp::SampleAccepted, this);
+    }
+}
+
+#endif /* TRAFFIC_APP_H */
@@ -0,0 +1,188 @@
+#ifndef WARMUP_FORK_H
+#define WARMUP_FORK_H
+
+#include "ns3/core-module.h"
+
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <iostream>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace ns3;
+
+/*
+ * WarmupFork runs the warm-up of a scenario once for several variants of it.
+ *
+ * ns-3 can't save a simulation to disk, but a forked process is an exact
+ * copy of it: nodes, devices, routing and peering state, pending events and
+ * the position of every random stream. At the fork time the process forks
+ * one child per variant (at most jobs at once). Each child applies its
+ * variant through the callback and runs on to the end; the parent waits for
+ * all of them and stops. A sweep over traffic parameters then pays the
+ * warm-up once instead of once per point.
+ *
+ *   WarmupFork::Schedule (Seconds (29.999), rates, MakeCallback (&SetRate), jobs);
+ *   Simulator::Run ();
+ *   if (WarmupFork::IsParent ())
+ *     ...  destroy and return, the children wrote the results
+ *   m_resultFile = WarmupFork::Decorate (m_resultFile);
+ *
+ * The children inherit the files opened before the fork, so each one should
+ * write its results to names made with Decorate (). Threads are not forked:
+ * don't fork a scenario that started a background writer.
+ */
+class WarmupFork
+{
+public:
+
+  static void Schedule (Time at, std::vector<std::string> variants, Callback<void, std::string> apply, uint32_t jobs);
+
+  /// True in the process that forked the variants, after they all ran
+  static bool IsParent (void);
+  /// Variant run by this process, empty if it was not forked
+  static std::string GetVariant (void);
+  /// Variants that could not be forked or did not exit with 0
+  static uint32_t GetFailed (void);
+  /// fileName with -<variant> inserted before its extension, unchanged if not forked
+  static std::string Decorate (std::string fileName);
+
+private:
+  static void Fork (void);
+  /// Wait for one child and count it if it failed
+  static void WaitOne (std::map<pid_t, std::string> &children);
+
+  static std::vector<std::string>    s_variants;
+  static Callback<void, std::string> s_apply;
+  static uint32_t                    s_jobs;
+  static bool                        s_parent;
+  static std::string                 s_variant;
+  static uint32_t                    s_failed;
+};
+
+std::vector<std::string> WarmupFork::s_variants;
+Callback<void, std::string> WarmupFork::s_apply;
+uint32_t WarmupFork::s_jobs = 1;
+bool WarmupFork::s_parent = false;
+std::string WarmupFork::s_variant = "";
+uint32_t WarmupFork::s_failed = 0;
+
+void
+WarmupFork::Schedule (Time at, std::vector<std::string> variants, Callback<void, std::string> apply, uint32_t jobs)
+{
+  s_variants = variants;
+  s_apply = apply;
+  s_jobs = std::max<uint32_t> (jobs, 1);
+  Simulator::Schedule (at, &WarmupFork::Fork);
+}
+
+bool
+WarmupFork::IsParent (void)
+{
+  return s_parent;
+}
+
+std::string
+WarmupFork::GetVariant (void)
+{
+  return s_variant;
+}
+
+uint32_t
+WarmupFork::GetFailed (void)
+{
+  return s_failed;
+}
+
+std::string
+WarmupFork::Decorate (std::string fileName)
+{
+  if (s_variant.empty () || fileName.empty ())
+    {
+      return fileName;
+    }
+  std::string::size_type dot = fileName.rfind ('.');
+  std::string::size_type slash = fileName.rfind ('/');
+  if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+    {
+      return fileName + "-" + s_variant;
+    }
+  return fileName.substr (0, dot) + "-" + s_variant + fileName.substr (dot);
+}
+
+void
+WarmupFork::Fork (void)
+{
+  // Whatever is still buffered would be written once by every child
+  std::cout.flush ();
+  std::cerr.flush ();
+  std::fflush (0);
+
+  std::map<pid_t, std::string> children;
+  for (uint32_t i = 0; i < s_variants.size (); ++i)
+    {
+      if (children.size () == s_jobs)
+        {
+          WaitOne (children);
+        }
+      pid_t pid = fork ();
+      if (pid < 0)
+        {
+          std::cerr << "Error: Can't fork variant " << s_variants[i] << "\n";
+          s_failed++;
+          continue;
+        }
+      if (pid == 0)
+        {
+          s_variant = s_variants[i];
+          s_apply (s_variant);
+          return;
+        }
+      children[pid] = s_variants[i];
+    }
+  while (!children.empty ())
+    {
+      WaitOne (children);
+    }
+
+  s_parent = true;
+  std::cout << "Warm-up forked " << s_variants.size () << " variants at " << Simulator::Now ().GetSeconds ()
+            << " s, " << s_failed << " failed" << std::endl;
+  Simulator::Stop ();
+}
+
+void
+WarmupFork::WaitOne (std::map<pid_t, std::string> &children)
+{
+  int status;
+  pid_t pid;
+  while ((pid = wait (&status)) < 0)
+    {
+      if (errno != EINTR)
+        {
+          // No child left to wait for
+          s_failed += children.size ();
+          children.clear ();
+          return;
+        }
+    }
+  std::map<pid_t, std::string>::iterator child = children.find (pid);
+  if (child == children.end ())
+    {
+      return;
+    }
+  if (!WIFEXITED (status) || WEXITSTATUS (status) != 0)
+    {
+      std::cerr << "Error: Variant " << child->second << " failed\n";
+      s_failed++;
+    }
+  children.erase (child);
+}
+
+#endif /* WARMUP_FORK_H */